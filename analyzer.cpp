@@ -0,0 +1,151 @@
+#include "analyzer.hpp"
+
+#include <QDebug>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "database.hpp"
+#include "image_loader.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kBatchSize = 100;
+
+// Write the metrics of the pictures to library, in a transaction. The paths
+// of the pictures whose metrics could not be written are added to failed.
+void storeMetrics(
+    const QString& library,
+    const QList<AnalyzedPicture>& pictures,
+    QSet<QString>* failed)
+{
+    QSqlDatabase db = openWorkerDatabase(library);
+    QSqlQuery query(db);
+    query.prepare(QString("UPDATE %1 SET %2 WHERE path = ?")
+                      .arg(kPicturesTable, kMetricsAssignments));
+    if (!db.transaction()) {
+        qDebug() << "failed to store metrics in" << library << ":"
+                 << db.lastError().text();
+        for (const auto& picture : pictures) {
+            failed->insert(picture.path);
+        }
+        return;
+    }
+
+    QSet<QString> failed_here;
+    for (const auto& picture : pictures) {
+        bindMetrics(query, picture.metrics);
+        query.addBindValue(picture.path);
+        if (!query.exec()) {
+            qDebug() << "failed to store the metrics of" << picture.path
+                     << ":" << query.lastError().text();
+            failed_here.insert(picture.path);
+        }
+    }
+    if (!db.commit()) {
+        qDebug() << "failed to store metrics in" << library << ":"
+                 << db.lastError().text();
+        db.rollback();
+        for (const auto& picture : pictures) {
+            failed->insert(picture.path);
+        }
+        return;
+    }
+    failed->unite(failed_here);
+}
+
+} // <anonymous>
+
+Analyzer::Analyzer(QSqlDatabase db, const Selection& selection)
+    : Job(selection.size() < 0
+              ? QString("Analyze pictures")
+              : QString("Analyze %1 pictures").arg(selection.size()),
+          Resource::kDatabase),
+      libraries_{libraryFiles(db)},
+      size_{selection.size()}
+{
+    auto computer = new MetricsComputer(&analyzed_);
+    computer->addUpstream(
+        new SelectionReader(db, selection, computer->input()));
+    addUpstream(computer);
+}
+
+Analyzer::Step Analyzer::step()
+{
+    progress(nr_analyzed_, size_);
+    QList<AnalyzedPicture> pictures = analyzed_.take(kBatchSize);
+    if (pictures.isEmpty()) {
+        if (!analyzed_.isDone()) {
+            return Step::kWait;
+        }
+        return success_ ? Step::kDone : Step::kFailed;
+    }
+
+    TraceScope trace{"Analyzer::step"};
+    // paths are unique in a library, it may be in several of them
+    QSet<QString> failed;
+    for (const auto& library : libraries_) {
+        storeMetrics(library, pictures, &failed);
+    }
+    success_ &= failed.isEmpty();
+    nr_analyzed_ += pictures.size();
+    return Step::kContinue;
+}
+
+MetricsWriter::MetricsWriter(
+    QSqlDatabase db, QHash<int, AnalyzedPicture> pictures)
+    : Job("Store metrics", Resource::kDatabase),
+      libraries_{libraryFiles(db)},
+      pictures_{std::move(pictures)}
+{
+}
+
+MetricsWriter::Step MetricsWriter::step()
+{
+    TraceScope trace{"MetricsWriter::step"};
+    const QList<AnalyzedPicture> pictures = pictures_.values();
+    QSet<QString> failed;
+    for (const auto& library : libraries_) {
+        storeMetrics(library, pictures, &failed);
+    }
+    for (auto it = pictures_.begin(); it != pictures_.end(); ++it) {
+        if (failed.contains(it->path)) {
+            failed_.insert(it.key(), it.value());
+        }
+    }
+    return failed_.isEmpty() ? Step::kDone : Step::kFailed;
+}
+
+MetricsComputer::MetricsComputer(MetricsQueue* output)
+    : Job("Compute metrics", Resource::kCpu), output_{output}
+{
+}
+
+MetricsComputer::Step MetricsComputer::step()
+{
+    QStringList paths = input_.take(1);
+    if (paths.isEmpty()) {
+        if (!input_.isDone()) {
+            return Step::kWait;
+        }
+        output_->close();
+        return Step::kDone;
+    }
+
+    TraceScope trace{"MetricsComputer::step"};
+    const QString& path = paths.front();
+    // the pictures are not read again soon
+    QImage thumbnail = loadThumbnail(path, true);
+    if (thumbnail.isNull()) {
+        // missing or unreadable, it is analyzed again next time
+        qDebug() << "failed to decode" << path;
+        return Step::kContinue;
+    }
+    output_->push({AnalyzedPicture{path, computeMetrics(thumbnail)}});
+    return Step::kContinue;
+}
+
+} // picpic
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QStringList>
+
+#include "jobs.hpp"
+#include "metrics.hpp"
+#include "selection.hpp"
+
+namespace picpic {
+
+struct AnalyzedPicture {
+    QString path;
+    PictureMetrics metrics;
+};
+
+using MetricsQueue = StageQueue<AnalyzedPicture>;
+
+// Computes the metrics of pictures analyzed before they were computed
+// along with their thumbnails. Their paths are read by a SelectionReader
+// stage, their thumbnails decoded by a MetricsComputer stage, and the
+// metrics are written on the database thread of the scheduler, to every
+// library holding the picture.
+class Analyzer : public Job {
+    Q_OBJECT
+public:
+    Analyzer(QSqlDatabase db, const Selection& selection);
+    int nrAnalyzed() const { return nr_analyzed_; }
+
+protected:
+    Step step() override;
+
+private:
+    const QStringList libraries_;
+    MetricsQueue analyzed_{this};
+    const int size_;
+    int nr_analyzed_{0};
+    bool success_{true};
+};
+
+// Writes the metrics computed by a model on the database thread of the
+// scheduler, to every library holding the pictures. The ones that could not
+// be written are kept for the model to try again.
+class MetricsWriter : public Job {
+    Q_OBJECT
+public:
+    // keyed by the ids of the model, which are only given back by failed()
+    MetricsWriter(QSqlDatabase db, QHash<int, AnalyzedPicture> pictures);
+    const QHash<int, AnalyzedPicture>& failed() const { return failed_; }
+
+protected:
+    Step step() override;
+
+private:
+    const QStringList libraries_;
+    const QHash<int, AnalyzedPicture> pictures_;
+    QHash<int, AnalyzedPicture> failed_;
+};
+
+// Stage of the analyses: the metrics of the pictures pushed to its input
+// are computed on their thumbnail, which is cached on the way, then pushed
+// to output. It is closed once they all are.
+class MetricsComputer : public Job {
+    Q_OBJECT
+public:
+    explicit MetricsComputer(MetricsQueue* output);
+    PathQueue* input() { return &input_; }
+
+protected:
+    Step step() override;
+
+private:
+    PathQueue input_{this};
+    MetricsQueue* output_;
+};
+
+} // picpic
@@ -0,0 +1,243 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QProcess>
+#include <QStandardPaths>
+
+#include "video.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kFilesPerDir = 200;
+constexpr int kImageQuality = 90;
+// one fixture in kPngRatio is a PNG, the others are JPEG
+constexpr int kPngRatio = 5;
+constexpr const char* kVideoSize = "1280x720";
+constexpr int kFfmpegTimeoutMs = 60000;
+
+bool runFfmpeg(const QString& ffmpeg, const QStringList& arguments)
+{
+    QProcess process;
+    process.start(ffmpeg, QStringList{"-v", "error", "-y"} + arguments);
+    if (!process.waitForFinished(kFfmpegTimeoutMs)
+        || process.exitStatus() != QProcess::NormalExit
+        || process.exitCode() != 0) {
+        std::fprintf(
+            stderr,
+            "ffmpeg failed: %s\n",
+            process.readAllStandardError().constData());
+        return false;
+    }
+    return true;
+}
+
+} // <anonymous>
+
+QImage syntheticImage(QSize size, quint32 seed)
+{
+    QImage image(size, QImage::Format_RGB32);
+    quint32 state = seed * 2654435761u + 1;
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            int noise = int(state & 0x1f) - 16;
+            int r = x * 255 / image.width() + noise;
+            int g = y * 255 / image.height() + noise;
+            int b = int(seed * 37 % 256) + noise;
+            line[x] = qRgb(
+                qBound(0, r, 255), qBound(0, g, 255), qBound(0, b, 255));
+        }
+    }
+    return image;
+}
+
+Bench::Bench(const BenchOptions& options) : options_{options}
+{
+}
+
+QString Bench::workDir(const QString& name) const
+{
+    QString path = dir_.path() + "/work/" + name;
+    QDir(path).removeRecursively();
+    QDir().mkpath(path);
+    return path;
+}
+
+const QString& Bench::fileTree()
+{
+    if (!file_tree_.isEmpty()) {
+        return file_tree_;
+    }
+
+    file_tree_ = dir_.path() + "/tree";
+    for (int i = 0; i < options_.nr_files; ++i) {
+        QString dir =
+            QString("%1/d%2/e%3")
+                .arg(file_tree_)
+                .arg(i / (kFilesPerDir * 10))
+                .arg(i / kFilesPerDir);
+        if (i % kFilesPerDir == 0) {
+            QDir().mkpath(dir);
+        }
+        QFile file{QString("%1/img_%2.jpg").arg(dir).arg(i)};
+        file.open(QIODevice::WriteOnly);
+    }
+    return file_tree_;
+}
+
+const QStringList& Bench::images()
+{
+    if (!images_.isEmpty()) {
+        return images_;
+    }
+
+    QString dir = dir_.path() + "/images";
+    QDir().mkpath(dir);
+    for (int i = 0; i < options_.nr_images; ++i) {
+        bool png = i % kPngRatio == kPngRatio - 1;
+        QString path =
+            QString("%1/img_%2.%3").arg(dir).arg(i).arg(png ? "png" : "jpg");
+        QImageWriter writer{path};
+        writer.setQuality(kImageQuality);
+        if (!writer.write(syntheticImage(options_.image_size, i))) {
+            std::fprintf(
+                stderr,
+                "cannot write %s: %s\n",
+                qPrintable(path),
+                qPrintable(writer.errorString()));
+            continue;
+        }
+        images_.push_back(path);
+    }
+    return images_;
+}
+
+const QStringList& Bench::videos()
+{
+    if (!videos_.isEmpty()) {
+        return videos_;
+    }
+    QString ffmpeg = QStandardPaths::findExecutable("ffmpeg");
+    if (ffmpeg.isEmpty()) {
+        return videos_;
+    }
+
+    QString dir = dir_.path() + "/videos";
+    QDir().mkpath(dir);
+    QString plain = dir + "/plain.mp4";
+    QString rotated = dir + "/rotated.mp4";
+    if (!runFfmpeg(
+            ffmpeg,
+            {"-f",
+             "lavfi",
+             "-i",
+             QString("testsrc2=size=%1:rate=30").arg(kVideoSize),
+             "-t",
+             "2",
+             "-pix_fmt",
+             "yuv420p",
+             plain})) {
+        return videos_;
+    }
+    // the display matrix is set by -display_rotation since FFmpeg 6, by
+    // the rotate metadata before
+    if (!runFfmpeg(
+            ffmpeg,
+            {"-display_rotation:v:0", "90", "-i", plain, "-c", "copy", rotated})
+        && !runFfmpeg(
+            ffmpeg,
+            {"-i",
+             plain,
+             "-c",
+             "copy",
+             "-metadata:s:v:0",
+             "rotate=90",
+             rotated})) {
+        return videos_;
+    }
+    videos_ = QStringList{plain, rotated};
+    return videos_;
+}
+
+void Bench::add(const QString& name, Function function)
+{
+    benchmarks_.emplace_back(name, std::move(function));
+}
+
+void Bench::run(const QStringList& filters)
+{
+    for (auto& benchmark : benchmarks_) {
+        const QString& name = benchmark.first;
+        bool selected = filters.isEmpty()
+                        || std::any_of(
+                            filters.begin(),
+                            filters.end(),
+                            [&](const QString& filter) {
+                                return name.contains(filter);
+                            });
+        if (!selected) {
+            continue;
+        }
+        std::fprintf(stderr, "running %s\n", qPrintable(name));
+        benchmark.second(*this);
+    }
+}
+
+void Bench::report(const QString& name, const QJsonObject& metrics)
+{
+    QJsonObject result = metrics;
+    result["name"] = name;
+    results_.append(result);
+}
+
+QJsonObject Bench::results() const
+{
+    QJsonObject options{
+        {"files", options_.nr_files},
+        {"images", options_.nr_images},
+        {"image_width", options_.image_size.width()},
+        {"image_height", options_.image_size.height()},
+    };
+    return QJsonObject{
+        {"qt_version", qVersion()},
+        {"video_backend", videoBackendName()},
+        {"options", options},
+        {"benchmarks", results_},
+    };
+}
+
+QJsonObject Bench::percentiles(QVector<double> samples_ms)
+{
+    if (samples_ms.isEmpty()) {
+        return {};
+    }
+
+    std::sort(samples_ms.begin(), samples_ms.end());
+    auto at = [&](double p) {
+        int i = int(std::ceil(p * samples_ms.size())) - 1;
+        return samples_ms[qBound(0, i, samples_ms.size() - 1)];
+    };
+    double sum = std::accumulate(samples_ms.begin(), samples_ms.end(), 0.);
+    return QJsonObject{
+        {"samples", samples_ms.size()},
+        {"p50_ms", at(0.5)},
+        {"p90_ms", at(0.9)},
+        {"p99_ms", at(0.99)},
+        {"mean_ms", sum / samples_ms.size()},
+    };
+}
+
+} // picpic
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+
+namespace picpic {
+
+struct BenchOptions {
+    int nr_files{10000};
+    int nr_images{40};
+    QSize image_size{4000, 3000};
+};
+
+// Runs the registered benchmarks and collects their metrics. Fixtures are
+// generated on first use in a temporary directory removed at exit, so that
+// results do not depend on the pictures of the machine.
+class Bench {
+public:
+    using Function = std::function<void(Bench& bench)>;
+
+    Bench(const BenchOptions& options);
+
+    const BenchOptions& options() const { return options_; }
+    // Empty directory for the benchmark being run
+    QString workDir(const QString& name) const;
+
+    // Directory tree of empty picture files, the scanner only reads names
+    const QString& fileTree();
+    // Synthetic JPEG and PNG pictures, noisy enough to decode like photos
+    const QStringList& images();
+    // Landscape MP4 clips encoded by the ffmpeg tool of the machine, the
+    // second one rotated by a quarter turn in its display matrix. Empty
+    // when ffmpeg is not found.
+    const QStringList& videos();
+
+    void add(const QString& name, Function function);
+    // Run the benchmarks whose name contains one of the filters, or all of
+    // them when there is no filter
+    void run(const QStringList& filters);
+    void report(const QString& name, const QJsonObject& metrics);
+    QJsonObject results() const;
+
+    // p50, p90, p99 and mean of samples in milliseconds
+    static QJsonObject percentiles(QVector<double> samples_ms);
+
+private:
+    BenchOptions options_;
+    QTemporaryDir dir_;
+    QString file_tree_;
+    QStringList images_;
+    QStringList videos_;
+    std::vector<std::pair<QString, Function>> benchmarks_;
+    QJsonArray results_;
+};
+
+// Gradient plus noise: flat images compress, decode and resample
+// unrealistically fast
+QImage syntheticImage(QSize size, quint32 seed);
+
+void addLibraryBenchmarks(Bench& bench);
+void addDecodeBenchmarks(Bench& bench);
+void addResampleBenchmarks(Bench& bench);
+
+} // picpic
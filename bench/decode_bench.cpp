@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <QBuffer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QImageReader>
+#include <QStandardPaths>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+#include <QColorSpace>
+#endif
+
+#include "bench.hpp"
+#include "color.hpp"
+#include "image_loader.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
+#include "thumbnail_cache.hpp"
+#include "video.hpp"
+
+namespace picpic {
+
+namespace {
+
+const QSize kScreenSize{1920, 1080};
+constexpr int kEnqueuedPerThread = 100000;
+constexpr int kEnqueueQueueSize = 256;
+constexpr int kMaxEnqueueThreads = 4;
+constexpr int kVideoRuns = 10;
+
+// Latency of single requests, each one is issued once the previous one is
+// done so that queueing is not measured
+void decodeLatency(Bench& bench, const QString& name, QSize size)
+{
+    const QStringList& images = bench.images();
+
+    ImageLoader loader;
+    QEventLoop loop;
+    QObject::connect(
+        &loader, &ImageLoader::imageLoaded, &loop, &QEventLoop::quit);
+    loader.start();
+
+    QVector<double> samples;
+    QElapsedTimer timer;
+    for (const auto& path : images) {
+        timer.start();
+        loader.load(path, size);
+        loop.exec();
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+    }
+
+    bench.report(name, Bench::percentiles(samples));
+}
+
+void decodeFullBench(Bench& bench)
+{
+    decodeLatency(bench, "decode_full", {});
+}
+
+void decodeScreenBench(Bench& bench)
+{
+    decodeLatency(bench, "decode_screen", kScreenSize);
+}
+
+// Resident set size in KiB, 0 where /proc is not available
+qint64 residentKiB()
+{
+    QFile status{"/proc/self/status"};
+    if (!status.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return 0;
+}
+
+// Decode latency of the pictures read through a file, as QImageReader does
+// by itself, then through a mapping of the file, as the loader does
+void decodeIoBench(Bench& bench)
+{
+    const QStringList& images = bench.images();
+    if (images.isEmpty()) {
+        return;
+    }
+
+    auto run = [&](bool mapped) {
+        QVector<double> samples;
+        qint64 peak_rss = 0;
+        QElapsedTimer timer;
+        for (const auto& path : images) {
+            timer.start();
+            if (mapped) {
+                MappedFile file{path};
+                file.adviseSequential();
+                QByteArray bytes = file.bytes();
+                QBuffer buffer{&bytes};
+                buffer.open(QIODevice::ReadOnly);
+                QImageReader reader{&buffer};
+                reader.read();
+                peak_rss = std::max(peak_rss, residentKiB());
+            }
+            else {
+                QImageReader reader{path};
+                reader.read();
+                peak_rss = std::max(peak_rss, residentKiB());
+            }
+            samples.push_back(timer.nsecsElapsed() / 1e6);
+        }
+        QJsonObject result = Bench::percentiles(samples);
+        result["peak_rss_kib"] = peak_rss;
+        return result;
+    };
+
+    // the first pass reads the files into the page cache for both
+    run(false);
+    QJsonObject read = run(false);
+    QJsonObject mapped = run(true);
+
+    bench.report(
+        "decode_io",
+        {
+            {"read_p50_ms", read["p50_ms"]},
+            {"read_p90_ms", read["p90_ms"]},
+            {"read_peak_rss_kib", read["peak_rss_kib"]},
+            {"mapped_p50_ms", mapped["p50_ms"]},
+            {"mapped_p90_ms", mapped["p90_ms"]},
+            {"mapped_peak_rss_kib", mapped["peak_rss_kib"]},
+        });
+}
+
+// Evict the files from the page cache so that the next reads hit the disk,
+// where it is supported
+void evictFromPageCache(const QStringList& paths)
+{
+    for (const auto& path : paths) {
+        MappedFile file{path};
+        file.setDropFromCache(true);
+    }
+}
+
+// Throughput of a batch of thumbnail requests, first with an empty
+// persistent cache and the pictures out of the page cache, then with the
+// thumbnails it stored. The first batch is run again with the files read
+// ahead by the prefetcher.
+void thumbnailBench(Bench& bench)
+{
+    const QStringList& images = bench.images();
+    if (images.isEmpty()) {
+        return;
+    }
+
+    auto run = [&](bool prefetch) {
+        // test mode is enabled, this is not the user's cache
+        QDir(
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/thumbnails")
+            .removeRecursively();
+        evictFromPageCache(images);
+
+        ImageLoader loader;
+        loader.setThumbnailCacheEnabled(true);
+        loader.setPrefetchEnabled(prefetch);
+        QEventLoop loop;
+        int remaining = 0;
+        QObject::connect(&loader, &ImageLoader::imageLoaded, &loop, [&] {
+            if (--remaining == 0) {
+                loop.quit();
+            }
+        });
+        loader.start();
+
+        auto batch = [&] {
+            QElapsedTimer timer;
+            timer.start();
+            remaining = images.size();
+            for (const auto& path : images) {
+                loader.load(
+                    path, QSize(kThumbnailCacheSize, kThumbnailCacheSize));
+            }
+            loop.exec();
+            qint64 elapsed = timer.nsecsElapsed();
+            return elapsed > 0 ? images.size() * 1e9 / elapsed : 0;
+        };
+
+        double cold = batch();
+        double warm = batch();
+        return std::make_pair(cold, warm);
+    };
+
+    auto [cold, warm] = run(false);
+    double cold_prefetch = run(true).first;
+
+    bench.report(
+        "thumbnails",
+        {
+            {"thumbnails", images.size()},
+            {"cold_per_sec", cold},
+            {"warm_per_sec", warm},
+            {"cold_prefetch_per_sec", cold_prefetch},
+        });
+}
+
+// Cost of load() for 1 to kMaxEnqueueThreads threads calling it at once,
+// while the decoding thread takes the requests. Paths do not exist so that
+// the decoding thread only contends on the queue.
+void enqueueBench(Bench& bench)
+{
+    QStringList paths;
+    for (int i = 0; i < kEnqueueQueueSize * 4; ++i) {
+        paths.push_back(QString("/nonexistent/picpic_%1.jpg").arg(i));
+    }
+
+    QJsonObject metrics;
+    for (int nr_threads = 1; nr_threads <= kMaxEnqueueThreads;
+         nr_threads *= 2) {
+        ImageLoader loader{kEnqueueQueueSize};
+        loader.start();
+
+        QElapsedTimer timer;
+        timer.start();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nr_threads; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < kEnqueuedPerThread; ++i) {
+                    loader.load(
+                        paths[(i + t) % paths.size()], kScreenSize, 0, i);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        qint64 elapsed = timer.nsecsElapsed();
+
+        metrics[QString("threads_%1_ns_per_load").arg(nr_threads)] =
+            double(elapsed) / kEnqueuedPerThread;
+    }
+    bench.report("loader_enqueue", metrics);
+}
+
+// Cost of the metrics of the thumbnails, relative to their decode at the
+// thumbnail size, which they are computed along with
+void metricsBench(Bench& bench)
+{
+    const QSize cache_size{kThumbnailCacheSize, kThumbnailCacheSize};
+    QVector<double> decode_ms;
+    QVector<double> metrics_ms;
+    QElapsedTimer timer;
+    for (const auto& path : bench.images()) {
+        timer.start();
+        QImageReader reader{path};
+        reader.setScaledSize(
+            reader.size().scaled(cache_size, Qt::KeepAspectRatio));
+        QImage image = reader.read();
+        decode_ms.push_back(timer.nsecsElapsed() / 1e6);
+
+        timer.start();
+        computeMetrics(image);
+        metrics_ms.push_back(timer.nsecsElapsed() / 1e6);
+    }
+
+    double decode_total =
+        std::accumulate(decode_ms.begin(), decode_ms.end(), 0.);
+    double metrics_total =
+        std::accumulate(metrics_ms.begin(), metrics_ms.end(), 0.);
+    QJsonObject metrics = Bench::percentiles(metrics_ms);
+    metrics["decode_percent"] =
+        decode_total > 0 ? 100 * metrics_total / decode_total : 0;
+    metrics["instruction_set"] = metricsInstructionSet();
+    bench.report("metrics", metrics);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+// Cost of the conversion of Display P3 pictures to sRGB, relative to their
+// decode. The generated pictures have no profile, one is set after the
+// decode as if it was embedded.
+void colorBench(Bench& bench)
+{
+    QVector<double> decode_ms;
+    QVector<double> convert_ms;
+    QElapsedTimer timer;
+    for (const auto& path : bench.images()) {
+        timer.start();
+        QImage image = QImageReader{path}.read();
+        decode_ms.push_back(timer.nsecsElapsed() / 1e6);
+
+        image.setColorSpace(QColorSpace::DisplayP3);
+        timer.start();
+        convertToDisplayColorSpace(image);
+        convert_ms.push_back(timer.nsecsElapsed() / 1e6);
+    }
+
+    double decode_total =
+        std::accumulate(decode_ms.begin(), decode_ms.end(), 0.);
+    double convert_total =
+        std::accumulate(convert_ms.begin(), convert_ms.end(), 0.);
+    QJsonObject metrics = Bench::percentiles(convert_ms);
+    metrics["decode_percent"] =
+        decode_total > 0 ? 100 * convert_total / decode_total : 0;
+    bench.report("color_p3", metrics);
+}
+#endif
+
+// Latency of the thumbnails of the generated clips, and whether their first
+// keyframe is decoded: landscape, and portrait for the rotated clip
+void videoKeyframeBench(Bench& bench)
+{
+    QJsonObject metrics{{"backend", videoBackendName()}};
+    const QStringList& videos = bench.videos();
+    if (videos.size() != 2) {
+        metrics["skipped"] = "ffmpeg not found";
+        bench.report("video_keyframe", metrics);
+        return;
+    }
+
+    const QSize cache_size{kThumbnailCacheSize, kThumbnailCacheSize};
+    QVector<double> samples;
+    QElapsedTimer timer;
+    QImage plain;
+    QImage rotated;
+    for (int i = 0; i < kVideoRuns; ++i) {
+        timer.start();
+        plain = decodeVideoKeyframe(videos[0], cache_size);
+        rotated = decodeVideoKeyframe(videos[1], cache_size);
+        samples.push_back(timer.nsecsElapsed() / 2e6);
+    }
+
+    metrics = Bench::percentiles(samples);
+    metrics["backend"] = videoBackendName();
+    metrics["plain_decoded"] =
+        !plain.isNull() && plain.width() > plain.height();
+    metrics["rotated_decoded"] =
+        !rotated.isNull() && rotated.width() < rotated.height();
+    bench.report("video_keyframe", metrics);
+}
+
+} // <anonymous>
+
+void addDecodeBenchmarks(Bench& bench)
+{
+    bench.add("decode_full", decodeFullBench);
+    bench.add("decode_screen", decodeScreenBench);
+    bench.add("decode_io", decodeIoBench);
+    bench.add("thumbnails", thumbnailBench);
+    bench.add("loader_enqueue", enqueueBench);
+    bench.add("metrics", metricsBench);
+    bench.add("video_keyframe", videoKeyframeBench);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    bench.add("color_p3", colorBench);
+#endif
+}
+
+} // picpic
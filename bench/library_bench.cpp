@@ -0,0 +1,285 @@
+#include <limits>
+
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlQuery>
+
+#include "bench.hpp"
+#include "database.hpp"
+#include "deleter.hpp"
+#include "exporter.hpp"
+#include "file_scanner.hpp"
+#include "inserter.hpp"
+#include "jobs.hpp"
+#include "row_store.hpp"
+#include "xmp.hpp"
+
+namespace picpic {
+
+namespace {
+
+double perSecond(double count, qint64 elapsed_ns)
+{
+    return elapsed_ns > 0 ? count * 1e9 / elapsed_ns : 0;
+}
+
+void scanBench(Bench& bench)
+{
+    const QString& tree = bench.fileTree();
+
+    // nothing consumes the paths, they are counted at the end
+    RatedPathQueue scanned{nullptr};
+    QEventLoop loop;
+    JobScheduler scheduler;
+    auto scanner = new FileScanner(tree, &scanned);
+    QObject::connect(scanner, &Job::finished, &loop, &QEventLoop::quit);
+
+    QElapsedTimer timer;
+    timer.start();
+    scheduler.add(scanner);
+    loop.exec();
+    qint64 elapsed = timer.nsecsElapsed();
+    int nr_files = scanned.take(std::numeric_limits<int>::max()).size();
+
+    bench.report(
+        "scan",
+        {
+            {"files", nr_files},
+            {"seconds", elapsed / 1e9},
+            {"files_per_sec", perSecond(nr_files, elapsed)},
+        });
+}
+
+// Fills a new library with the file tree, shared by the insert and delete
+// benchmarks
+QSqlDatabase insertTree(Bench& bench, qint64* elapsed, int* nr_rows)
+{
+    QSqlDatabase db =
+        openPicDatabase(bench.workDir("library") + "/library.db");
+
+    QEventLoop loop;
+    JobScheduler scheduler;
+    QElapsedTimer timer;
+    timer.start();
+    auto inserter = new Inserter(db, bench.fileTree());
+    QObject::connect(inserter, &Job::finished, &loop, &QEventLoop::quit);
+    scheduler.add(inserter);
+    loop.exec();
+    *elapsed = timer.nsecsElapsed();
+
+    QSqlQuery query(db);
+    query.exec(QString("SELECT COUNT(*) FROM %1").arg(kPicturesTable));
+    *nr_rows = query.next() ? query.value(0).toInt() : 0;
+    return db;
+}
+
+void insertBench(Bench& bench)
+{
+    // generate the tree first, it must not be measured
+    bench.fileTree();
+
+    qint64 elapsed = 0;
+    int nr_rows = 0;
+    insertTree(bench, &elapsed, &nr_rows);
+
+    bench.report(
+        "insert",
+        {
+            {"rows", nr_rows},
+            {"seconds", elapsed / 1e9},
+            {"rows_per_sec", perSecond(nr_rows, elapsed)},
+        });
+}
+
+void deleteBench(Bench& bench)
+{
+    bench.fileTree();
+
+    qint64 elapsed = 0;
+    int nr_rows = 0;
+    QSqlDatabase db = insertTree(bench, &elapsed, &nr_rows);
+
+    QVector<int> ids;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.exec(QString("SELECT id FROM %1").arg(kPicturesTable));
+    while (query.next()) {
+        ids.push_back(query.value(0).toInt());
+    }
+
+    const int nr_ids = ids.size();
+    QEventLoop loop;
+    JobScheduler scheduler;
+    QElapsedTimer timer;
+    timer.start();
+    auto deleter =
+        new Deleter(db, Selection::withIds(kPicturesTable, std::move(ids)));
+    QObject::connect(deleter, &Job::finished, &loop, &QEventLoop::quit);
+    scheduler.add(deleter);
+    loop.exec();
+    elapsed = timer.nsecsElapsed();
+
+    bench.report(
+        "delete",
+        {
+            {"rows", nr_ids},
+            {"seconds", elapsed / 1e9},
+            {"rows_per_sec", perSecond(nr_ids, elapsed)},
+        });
+}
+
+void rowsBench(Bench& bench)
+{
+    bench.fileTree();
+
+    qint64 elapsed = 0;
+    int nr_rows = 0;
+    QSqlDatabase db = insertTree(bench, &elapsed, &nr_rows);
+
+    // loaded like PicModel::select() does
+    RowStore rows;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    QElapsedTimer timer;
+    timer.start();
+    query.exec(QString("SELECT id, path, rating, rotation, sharpness, clipped "
+                       "FROM %1 ORDER BY path")
+                   .arg(kPicturesTable));
+    while (query.next()) {
+        rows.append(
+            query.value(0).toInt(),
+            query.value(1).toString(),
+            query.value(2).toInt(),
+            query.value(3).toInt(),
+            query.value(4).toFloat(),
+            query.value(5).toFloat());
+    }
+    rows.squeeze();
+    elapsed = timer.nsecsElapsed();
+
+    qint64 path_bytes = 0;
+    for (int row = 0; row < rows.size(); ++row) {
+        path_bytes += rows.path(row).size() * sizeof(QChar);
+    }
+
+    bench.report(
+        "rows",
+        {
+            {"rows", rows.size()},
+            {"seconds", elapsed / 1e9},
+            {"rows_per_sec", perSecond(rows.size(), elapsed)},
+            {"bytes_per_row",
+             rows.size() > 0 ? double(rows.memoryUsage()) / rows.size() : 0},
+            {"path_bytes_per_row",
+             rows.size() > 0 ? double(path_bytes) / rows.size() : 0},
+        });
+}
+
+void exportBench(Bench& bench)
+{
+    const QStringList& srcs = bench.images();
+    if (srcs.isEmpty()) {
+        return;
+    }
+    qint64 bytes = 0;
+    for (const auto& src : srcs) {
+        bytes += QFileInfo(src).size();
+    }
+
+    // the pictures are read from a library, as the exports do
+    QSqlDatabase db =
+        openPicDatabase(bench.workDir("export_library") + "/library.db");
+    QEventLoop loop;
+    JobScheduler scheduler;
+    auto inserter = new Inserter(db, QFileInfo(srcs.front()).path());
+    QObject::connect(inserter, &Job::finished, &loop, &QEventLoop::quit);
+    scheduler.add(inserter);
+    loop.exec();
+
+    int copied = 0;
+    auto exporter = new Exporter(
+        bench.workDir("export"),
+        db,
+        Selection::matching(kPicturesTable, {}, srcs.size()));
+    QObject::connect(exporter, &Job::finished, &loop, [&, exporter] {
+        copied = exporter->nrCopied();
+        loop.quit();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    scheduler.add(exporter);
+    loop.exec();
+    qint64 elapsed = timer.nsecsElapsed();
+
+    bench.report(
+        "export",
+        {
+            {"files", copied},
+            {"bytes", bytes},
+            {"seconds", elapsed / 1e9},
+            {"mb_per_sec", perSecond(bytes / 1e6, elapsed)},
+        });
+}
+
+// Sidecars of the file tree: created, written again with the same ratings,
+// which is most of a sync, then read. They are removed at the end, the
+// other benchmarks scan the tree without them.
+void xmpBench(Bench& bench)
+{
+    QStringList paths;
+    QDirIterator it{
+        bench.fileTree(), {"*.jpg"}, QDir::Files, QDirIterator::Subdirectories};
+    while (it.hasNext()) {
+        paths.push_back(it.next());
+    }
+
+    QElapsedTimer timer;
+    auto writeAll = [&] {
+        timer.start();
+        for (int i = 0; i < paths.size(); ++i) {
+            writeSidecarRating(paths[i], i % 5 + 1);
+        }
+        return timer.nsecsElapsed();
+    };
+    qint64 created = writeAll();
+    qint64 unchanged = writeAll();
+
+    timer.start();
+    int nr_rated = 0;
+    for (const auto& path : paths) {
+        nr_rated += readSidecarRating(path) > 0 ? 1 : 0;
+    }
+    qint64 read = timer.nsecsElapsed();
+
+    for (const auto& path : paths) {
+        QFile::remove(sidecarPath(path));
+    }
+
+    bench.report(
+        "xmp",
+        {
+            {"files", paths.size()},
+            {"rated", nr_rated},
+            {"created_per_sec", perSecond(paths.size(), created)},
+            {"unchanged_per_sec", perSecond(paths.size(), unchanged)},
+            {"read_per_sec", perSecond(paths.size(), read)},
+        });
+}
+
+} // <anonymous>
+
+void addLibraryBenchmarks(Bench& bench)
+{
+    bench.add("scan", scanBench);
+    bench.add("insert", insertBench);
+    bench.add("delete", deleteBench);
+    bench.add("rows", rowsBench);
+    bench.add("export", exportBench);
+    bench.add("xmp", xmpBench);
+}
+
+} // picpic
@@ -0,0 +1,91 @@
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QStandardPaths>
+
+#include "bench.hpp"
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    // keep the thumbnail cache of the user out of the measurements
+    QStandardPaths::setTestModeEnabled(true);
+
+    picpic::BenchOptions defaults;
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Measure the throughput of picpic on generated fixtures and print "
+        "the results as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument(
+        "filters",
+        "Only run the benchmarks containing a filter.",
+        "[filters...]");
+    QCommandLineOption files_option(
+        "files",
+        "Number of files in the scanned tree.",
+        "count",
+        QString::number(defaults.nr_files));
+    QCommandLineOption images_option(
+        "images",
+        "Number of pictures decoded and exported.",
+        "count",
+        QString::number(defaults.nr_images));
+    QCommandLineOption width_option(
+        "image-width",
+        "Width of the pictures.",
+        "pixels",
+        QString::number(defaults.image_size.width()));
+    QCommandLineOption height_option(
+        "image-height",
+        "Height of the pictures.",
+        "pixels",
+        QString::number(defaults.image_size.height()));
+    QCommandLineOption output_option(
+        QStringList{"o", "output"},
+        "Write the results to <file> instead of the standard output.",
+        "file");
+    parser.addOption(files_option);
+    parser.addOption(images_option);
+    parser.addOption(width_option);
+    parser.addOption(height_option);
+    parser.addOption(output_option);
+    parser.process(app);
+
+    picpic::BenchOptions options;
+    options.nr_files = parser.value(files_option).toInt();
+    options.nr_images = parser.value(images_option).toInt();
+    options.image_size = QSize(
+        parser.value(width_option).toInt(),
+        parser.value(height_option).toInt());
+    if (options.nr_files < 0 || options.nr_images < 0
+        || options.image_size.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    picpic::Bench bench{options};
+    picpic::addLibraryBenchmarks(bench);
+    picpic::addDecodeBenchmarks(bench);
+    picpic::addResampleBenchmarks(bench);
+    bench.run(parser.positionalArguments());
+
+    QByteArray json = QJsonDocument(bench.results()).toJson();
+    if (!parser.isSet(output_option)) {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    QFile file{parser.value(output_option)};
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        std::fprintf(
+            stderr,
+            "cannot write %s: %s\n",
+            qPrintable(file.fileName()),
+            qPrintable(file.errorString()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <functional>
+
+#include <QElapsedTimer>
+
+#include "bench.hpp"
+#include "resample.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kRuns = 5;
+
+const QSize k24Mp{6000, 4000};
+const QSize k50Mp{8688, 5792};
+const QSize kThumbnail{256, 256};
+const QSize kScreen{1920, 1080};
+
+// Median duration of kRuns calls, in milliseconds
+double medianMs(const std::function<void()>& function)
+{
+    QVector<double> samples;
+    QElapsedTimer timer;
+    for (int i = 0; i < kRuns; ++i) {
+        timer.start();
+        function();
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[kRuns / 2];
+}
+
+void compare(Bench& bench, const QString& name, QSize source, QSize bound)
+{
+    QImage image = syntheticImage(source, 0);
+    QSize size = source.scaled(bound, Qt::KeepAspectRatio);
+
+    double qt_ms = medianMs([&] {
+        image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    });
+    double resample_ms = medianMs([&] { resample(image, size); });
+
+    bench.report(
+        name,
+        {
+            {"instruction_set", resampleInstructionSet()},
+            {"qt_smooth_ms", qt_ms},
+            {"resample_ms", resample_ms},
+            {"speedup", resample_ms > 0 ? qt_ms / resample_ms : 0},
+        });
+}
+
+} // <anonymous>
+
+void addResampleBenchmarks(Bench& bench)
+{
+    bench.add("resample_24mp_thumbnail", [](Bench& bench) {
+        compare(bench, "resample_24mp_thumbnail", k24Mp, kThumbnail);
+    });
+    bench.add("resample_24mp_screen", [](Bench& bench) {
+        compare(bench, "resample_24mp_screen", k24Mp, kScreen);
+    });
+    bench.add("resample_50mp_thumbnail", [](Bench& bench) {
+        compare(bench, "resample_50mp_thumbnail", k50Mp, kThumbnail);
+    });
+    bench.add("resample_50mp_screen", [](Bench& bench) {
+        compare(bench, "resample_50mp_screen", k50Mp, kScreen);
+    });
+}
+
+} // picpic
@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include "bench.hpp"
+#include "database.hpp"
+#include "deleter.hpp"
+#include "image_viewer.hpp"
+#include "inserter.hpp"
+#include "jobs.hpp"
+#include "pic_model.hpp"
+#include "pixmap_cache.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kNrLibraries = 2;
+constexpr int kTickMs = 10;
+constexpr int kVisibleRows = 40;
+constexpr int kCachedPictures = 5;
+constexpr int kViewerWidth = 1280;
+constexpr int kViewerHeight = 800;
+// one tick in kSwitchRatio switches the library, one in kNavigateRatio
+// shows the next picture: faster than they are decoded
+constexpr int kSwitchRatio = 20;
+constexpr int kNavigateRatio = 3;
+
+enum Activity {
+    kSwitch = 1,
+    kNavigate = 2,
+    kJobs = 4,
+};
+
+struct StressOptions {
+    qint64 duration_ms{20000};
+    qint64 hang_timeout_ms{10000};
+};
+
+// Aborts when the event loop stops running for timeout, so that a hang
+// leaves a core dump and the stacks of all threads instead of a stuck run
+class Watchdog {
+public:
+    explicit Watchdog(qint64 timeout_ms) : timeout_ms_{timeout_ms}
+    {
+        clock_.start();
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~Watchdog()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            stopped_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    // called by the event loop, activity is a string literal
+    void beat(const char* activity)
+    {
+        activity_.store(activity, std::memory_order_relaxed);
+        last_beat_ms_.store(clock_.elapsed(), std::memory_order_relaxed);
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock lock{mutex_};
+        while (!cv_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+            return stopped_;
+        })) {
+            qint64 stuck_ms =
+                clock_.elapsed()
+                - last_beat_ms_.load(std::memory_order_relaxed);
+            if (stuck_ms > timeout_ms_) {
+                std::fprintf(
+                    stderr,
+                    "the event loop is stuck for %lld ms in %s\n",
+                    static_cast<long long>(stuck_ms),
+                    activity_.load(std::memory_order_relaxed));
+                std::abort();
+            }
+        }
+    }
+
+    const qint64 timeout_ms_;
+    QElapsedTimer clock_;
+    std::atomic<qint64> last_beat_ms_{0};
+    std::atomic<const char*> activity_{"starting"};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopped_{false};
+    std::thread thread_;
+};
+
+double elapsedMs(const QElapsedTimer& timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+// Libraries of the generated pictures, switched between by the runs
+QStringList createLibraries(Bench& bench)
+{
+    static QStringList libraries;
+    if (!libraries.isEmpty()) {
+        return libraries;
+    }
+
+    const QString images = QFileInfo(bench.images().front()).path();
+    for (int i = 0; i < kNrLibraries; ++i) {
+        QString path =
+            bench.workDir(QString("library%1").arg(i)) + "/library.db";
+        QEventLoop loop;
+        JobScheduler scheduler;
+        auto inserter = new Inserter(openPicDatabase(path), images);
+        QObject::connect(inserter, &Job::finished, &loop, &QEventLoop::quit);
+        scheduler.add(inserter);
+        loop.exec();
+        libraries.push_back(path);
+    }
+    return libraries;
+}
+
+// Does what a user in a hurry does, all at once on the GUI thread, while
+// the loaders and the jobs run on theirs: switch libraries while their
+// thumbnails load, scroll, show pictures faster than they are decoded,
+// scan and delete in the library shown.
+class StressRun {
+public:
+    StressRun(Bench& bench, const StressOptions& options, int activities)
+        : bench_{bench},
+          options_{options},
+          activities_{activities},
+          libraries_{createLibraries(bench)},
+          images_{bench.images()},
+          watchdog_{options.hang_timeout_ms}
+    {
+    }
+
+    ~StressRun()
+    {
+        // the loaders are stopped while they may still emit
+        watchdog_.beat("teardown");
+        delete model_;
+        viewer_.reset();
+    }
+
+    QJsonObject run()
+    {
+        if (activities_ & (kSwitch | kJobs)) {
+            switchLibrary();
+        }
+        if (activities_ & kNavigate) {
+            cache_ = std::make_unique<PixmapCache>(kCachedPictures);
+            viewer_ = std::make_unique<ImageViewer>(cache_.get());
+            viewer_->setDecodeToFit(true);
+            viewer_->resize(kViewerWidth, kViewerHeight);
+            viewer_->show();
+            QObject::connect(
+                viewer_.get(), &ImageViewer::painted, [this](bool decoded) {
+                    if (decoded && navigation_.isValid()) {
+                        navigate_ms_.push_back(elapsedMs(navigation_));
+                        navigation_.invalidate();
+                    }
+                });
+        }
+
+        qint64 thumbnails = counterValue(Counter::kThumbnailCacheHits)
+                            + counterValue(Counter::kThumbnailCacheMisses);
+        qint64 decodes = counterValue(Counter::kDecodes);
+        qint64 inserted = counterValue(Counter::kInsertedRows);
+        qint64 deleted = counterValue(Counter::kDeletedRows);
+
+        QEventLoop loop;
+        QTimer ticks;
+        ticks.setTimerType(Qt::PreciseTimer);
+        ticks.setInterval(kTickMs);
+        QObject::connect(&ticks, &QTimer::timeout, [this] { tick(); });
+        QTimer::singleShot(options_.duration_ms, &loop, &QEventLoop::quit);
+
+        QElapsedTimer timer;
+        timer.start();
+        last_tick_.start();
+        ticks.start();
+        loop.exec();
+        ticks.stop();
+        const qint64 elapsed = timer.nsecsElapsed();
+
+        auto perSecond = [elapsed](qint64 count) {
+            return elapsed > 0 ? count * 1e9 / elapsed : 0;
+        };
+        thumbnails = counterValue(Counter::kThumbnailCacheHits)
+                     + counterValue(Counter::kThumbnailCacheMisses)
+                     - thumbnails;
+        decodes = counterValue(Counter::kDecodes) - decodes;
+        inserted = counterValue(Counter::kInsertedRows) - inserted;
+        deleted = counterValue(Counter::kDeletedRows) - deleted;
+
+        QJsonObject metrics{
+            {"seconds", elapsed / 1e9},
+            {"event_loop_lag", Bench::percentiles(lag_ms_)},
+            {"max_lag_ms", max_lag_ms_},
+            {"thumbnails_per_sec", perSecond(thumbnails)},
+            {"decodes_per_sec", perSecond(decodes)},
+        };
+        if (activities_ & kSwitch) {
+            metrics["switches"] = switch_ms_.size();
+            metrics["switch"] = Bench::percentiles(switch_ms_);
+            metrics["teardown"] = Bench::percentiles(teardown_ms_);
+        }
+        if (activities_ & kNavigate) {
+            metrics["navigations"] = nr_navigations_;
+            metrics["navigate"] = Bench::percentiles(navigate_ms_);
+            metrics["superseded"] = nr_superseded_;
+        }
+        if (activities_ & kJobs) {
+            metrics["jobs"] = nr_jobs_;
+            metrics["failed_jobs"] = nr_failed_jobs_;
+            metrics["inserted_per_sec"] = perSecond(inserted);
+            metrics["deleted_per_sec"] = perSecond(deleted);
+        }
+        return metrics;
+    }
+
+private:
+    void tick()
+    {
+        double lag_ms = std::max(elapsedMs(last_tick_) - kTickMs, 0.);
+        lag_ms_.push_back(lag_ms);
+        max_lag_ms_ = std::max(max_lag_ms_, lag_ms);
+        last_tick_.start();
+        watchdog_.beat("tick");
+
+        if ((activities_ & kSwitch) && random_() % kSwitchRatio == 0) {
+            switchLibrary();
+        }
+        else if (model_) {
+            watchdog_.beat("scroll");
+            scroll();
+        }
+        if ((activities_ & kNavigate) && random_() % kNavigateRatio == 0) {
+            watchdog_.beat("navigate");
+            navigate();
+        }
+        if ((activities_ & kJobs) && !job_running_) {
+            watchdog_.beat("startJob");
+            startJob();
+        }
+    }
+
+    // as MainWindow::createNewModel
+    void switchLibrary()
+    {
+        watchdog_.beat("switchLibrary");
+        QElapsedTimer timer;
+        timer.start();
+        if (model_) {
+            delete model_;
+            model_ = nullptr;
+            teardown_ms_.push_back(elapsedMs(timer));
+        }
+        library_ = (library_ + 1) % libraries_.size();
+        model_ = new PicModel(
+            openPicDatabase(libraries_[library_]),
+            kPicturesTable,
+            &scheduler_,
+            nullptr);
+        model_->select();
+        switch_ms_.push_back(elapsedMs(timer));
+    }
+
+    // as the views do after painting
+    void scroll()
+    {
+        int rows = model_->rowCount();
+        if (rows == 0) {
+            return;
+        }
+        int first = int(random_() % rows);
+        int last = std::min(first + kVisibleRows, rows) - 1;
+        for (int row = first; row <= last; ++row) {
+            model_->data(
+                model_->index(row, PicModel::kColPath), Qt::DecorationRole);
+        }
+        model_->setVisibleRows(first, last);
+    }
+
+    void navigate()
+    {
+        if (navigation_.isValid()) {
+            ++nr_superseded_;
+        }
+        image_ = (image_ + 1) % images_.size();
+        navigation_.start();
+        viewer_->setImagePath(images_[image_]);
+        viewer_->preload(images_[(image_ + 1) % images_.size()]);
+        ++nr_navigations_;
+    }
+
+    // scan the file tree into the library shown, then delete it again
+    void startJob()
+    {
+        const QString& tree = bench_.fileTree();
+        Job* job = nullptr;
+        if (insert_next_) {
+            job = new Inserter(model_->database(), tree);
+        }
+        else {
+            job = new Deleter(
+                model_->database(),
+                Selection::matching(
+                    kPicturesTable, QString("path LIKE '%1/%'").arg(tree)));
+        }
+        insert_next_ = !insert_next_;
+        job_running_ = true;
+        QObject::connect(job, &Job::finished, [this](bool success) {
+            job_running_ = false;
+            ++nr_jobs_;
+            nr_failed_jobs_ += success ? 0 : 1;
+            // as MainWindow does once a scan is done
+            if (model_) {
+                watchdog_.beat("select");
+                model_->select();
+            }
+        });
+        scheduler_.add(job);
+    }
+
+    Bench& bench_;
+    const StressOptions options_;
+    const int activities_;
+    const QStringList libraries_;
+    const QStringList images_;
+    // started once the fixtures are generated
+    Watchdog watchdog_;
+    // deterministic, the runs are comparable
+    std::minstd_rand random_{1};
+    int library_{0};
+    PicModel* model_{nullptr};
+    std::unique_ptr<PixmapCache> cache_;
+    std::unique_ptr<ImageViewer> viewer_;
+    int image_{0};
+    // valid while the picture shown is being decoded
+    QElapsedTimer navigation_;
+    QElapsedTimer last_tick_;
+    bool insert_next_{true};
+    bool job_running_{false};
+    int nr_jobs_{0};
+    int nr_failed_jobs_{0};
+    int nr_navigations_{0};
+    int nr_superseded_{0};
+    QVector<double> lag_ms_;
+    double max_lag_ms_{0};
+    QVector<double> switch_ms_;
+    QVector<double> teardown_ms_;
+    QVector<double> navigate_ms_;
+    // destroyed first, the steps still running are waited for before the
+    // libraries are closed
+    JobScheduler scheduler_;
+};
+
+void addStressRuns(Bench& bench, const StressOptions& options)
+{
+    auto add = [&](const QString& name, int activities) {
+        bench.add(name, [name, options, activities](Bench& bench) {
+            if (activities & kJobs) {
+                // generated before the run, it must not be measured
+                bench.fileTree();
+            }
+            StressRun run{bench, options, activities};
+            QJsonObject metrics = run.run();
+            bench.report(name, metrics);
+        });
+    };
+    add("switch", kSwitch);
+    add("navigate", kNavigate);
+    add("soak", kSwitch | kNavigate | kJobs);
+}
+
+} // <anonymous>
+
+} // picpic
+
+int main(int argc, char* argv[])
+{
+    // the viewers are shown, without a display too
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    // keep the thumbnail cache of the user out of the runs
+    QStandardPaths::setTestModeEnabled(true);
+
+    picpic::BenchOptions defaults;
+    picpic::StressOptions stress_defaults;
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Switch libraries, navigate, scan and delete concurrently on "
+        "generated fixtures, abort when the event loop hangs, and print the "
+        "latencies and throughputs as JSON. Build with "
+        "-DPICPIC_SANITIZE=thread to look for races.");
+    parser.addHelpOption();
+    parser.addPositionalArgument(
+        "filters",
+        "Only run the scenarios containing a filter: switch, navigate or "
+        "soak.",
+        "[filters...]");
+    QCommandLineOption duration_option(
+        "duration",
+        "Duration of each scenario.",
+        "seconds",
+        QString::number(stress_defaults.duration_ms / 1000));
+    QCommandLineOption hang_option(
+        "hang-timeout",
+        "Abort when the event loop is stuck for longer.",
+        "seconds",
+        QString::number(stress_defaults.hang_timeout_ms / 1000));
+    QCommandLineOption files_option(
+        "files",
+        "Number of files scanned and deleted.",
+        "count",
+        QString::number(defaults.nr_files));
+    QCommandLineOption images_option(
+        "images",
+        "Number of pictures in the libraries.",
+        "count",
+        QString::number(defaults.nr_images));
+    QCommandLineOption width_option(
+        "image-width",
+        "Width of the pictures.",
+        "pixels",
+        QString::number(defaults.image_size.width()));
+    QCommandLineOption height_option(
+        "image-height",
+        "Height of the pictures.",
+        "pixels",
+        QString::number(defaults.image_size.height()));
+    QCommandLineOption output_option(
+        QStringList{"o", "output"},
+        "Write the results to <file> instead of the standard output.",
+        "file");
+    parser.addOption(duration_option);
+    parser.addOption(hang_option);
+    parser.addOption(files_option);
+    parser.addOption(images_option);
+    parser.addOption(width_option);
+    parser.addOption(height_option);
+    parser.addOption(output_option);
+    parser.process(app);
+
+    picpic::StressOptions stress;
+    stress.duration_ms = parser.value(duration_option).toLongLong() * 1000;
+    stress.hang_timeout_ms = parser.value(hang_option).toLongLong() * 1000;
+    picpic::BenchOptions options;
+    options.nr_files = parser.value(files_option).toInt();
+    options.nr_images = parser.value(images_option).toInt();
+    options.image_size = QSize(
+        parser.value(width_option).toInt(),
+        parser.value(height_option).toInt());
+    if (stress.duration_ms <= 0 || stress.hang_timeout_ms <= 0
+        || options.nr_files < 0 || options.nr_images <= 0
+        || options.image_size.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    picpic::Bench bench{options};
+    picpic::addStressRuns(bench, stress);
+    bench.run(parser.positionalArguments());
+
+    QByteArray json = QJsonDocument(bench.results()).toJson();
+    if (!parser.isSet(output_option)) {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    QFile file{parser.value(output_option)};
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        std::fprintf(
+            stderr,
+            "cannot write %s: %s\n",
+            qPrintable(file.fileName()),
+            qPrintable(file.errorString()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "color.hpp"
+
+#include <QtGlobal>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <QColorSpace>
+#include <QColorTransform>
+
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+// a library holds pictures of a handful of cameras and editors
+constexpr size_t kMaxTransforms = 16;
+
+std::mutex transforms_mutex;
+// QColorSpace has no hash, the list is short
+std::vector<std::pair<QColorSpace, QColorTransform>> transforms;
+
+QColorTransform transformToDisplay(const QColorSpace& source)
+{
+    std::lock_guard lock{transforms_mutex};
+    for (const auto& entry : transforms) {
+        if (entry.first == source) {
+            return entry.second;
+        }
+    }
+    if (transforms.size() == kMaxTransforms) {
+        transforms.erase(transforms.begin());
+    }
+    transforms.emplace_back(
+        source, source.transformationToColorSpace(QColorSpace::SRgb));
+    return transforms.back().second;
+}
+
+} // <anonymous>
+
+void convertToDisplayColorSpace(QImage& image)
+{
+    const QColorSpace source = image.colorSpace();
+    if (image.isNull() || !source.isValid() || source == QColorSpace::SRgb) {
+        return;
+    }
+
+    TraceScope trace{"convertToDisplayColorSpace"};
+    // the transforms go through lookup tables, vectorized by Qt, for these
+    // formats only
+    if (image.format() != QImage::Format_RGB32
+        && image.format() != QImage::Format_ARGB32
+        && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(
+            image.hasAlphaChannel() ? QImage::Format_ARGB32
+                                    : QImage::Format_RGB32);
+    }
+    image.applyColorTransform(transformToDisplay(source));
+    // the pixels are converted, only the tag is changed
+    image.setColorSpace(QColorSpace::SRgb);
+}
+
+} // picpic
+
+#else
+
+namespace picpic {
+
+void convertToDisplayColorSpace(QImage&)
+{
+}
+
+} // picpic
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QImage>
+
+namespace picpic {
+
+// Convert image from its embedded ICC profile to the color space of the
+// display, sRGB: Qt paints as if the screens were sRGB. The transforms are
+// built once per source profile and shared by the decoding threads.
+// Profiles are only read with Qt 5.14 or later, before that images are
+// left untouched.
+void convertToDisplayColorSpace(QImage& image);
+
+} // picpic
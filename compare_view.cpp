@@ -0,0 +1,77 @@
+#include "compare_view.hpp"
+
+#include <algorithm>
+
+#include <QGridLayout>
+
+namespace picpic {
+
+CompareView::CompareView(PixmapCache* cache, QWidget* parent)
+    : QWidget(parent)
+{
+    QGridLayout* grid = new QGridLayout(this);
+    grid->setContentsMargins(0, 0, 0, 0);
+
+    for (int i = 0; i < kMaxPictures; ++i) {
+        ImageViewer* pane = new ImageViewer(cache, this);
+        pane->setAlignment(Qt::AlignCenter);
+        pane->setDecodeToFit(true);
+        pane->hide();
+        connect(
+            pane,
+            &ImageViewer::viewChanged,
+            this,
+            [this, pane](qreal zoom, QPointF center) {
+                onViewChanged(pane, zoom, center);
+            });
+        panes_.push_back(pane);
+    }
+}
+
+void CompareView::setImagePaths(
+    const QStringList& paths, const QVector<int>& rotations)
+{
+    int count = std::min<int>(paths.size(), kMaxPictures);
+    QGridLayout* grid = static_cast<QGridLayout*>(layout());
+
+    if (count != nr_visible_) {
+        int columns = count <= 3 ? count : 2;
+        for (int i = 0; i < panes_.size(); ++i) {
+            grid->removeWidget(panes_[i]);
+            panes_[i]->setVisible(i < count);
+            if (i < count) {
+                grid->addWidget(panes_[i], i / columns, i % columns);
+            }
+        }
+        nr_visible_ = count;
+        // panes decode at their own size, make sure it is up to date
+        grid->activate();
+    }
+
+    // each pane has its own loader, pictures are decoded in parallel
+    for (int i = 0; i < count; ++i) {
+        panes_[i]->setImagePath(paths[i], rotations.value(i));
+    }
+}
+
+void CompareView::preload(
+    const QStringList& paths, const QVector<int>& rotations)
+{
+    // spread the pictures over the panes preloaders so they decode in
+    // parallel at the size they will be displayed
+    int count = std::min<int>(paths.size(), std::max(nr_visible_, 1));
+    for (int i = 0; i < count; ++i) {
+        panes_[i]->preload(paths[i], rotations.value(i));
+    }
+}
+
+void CompareView::onViewChanged(ImageViewer* source, qreal zoom, QPointF center)
+{
+    for (ImageViewer* pane : panes_) {
+        if (pane != source) {
+            pane->setView(zoom, center);
+        }
+    }
+}
+
+} // picpic
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QStringList>
+#include <QVector>
+#include <QWidget>
+
+#include "image_viewer.hpp"
+#include "pixmap_cache.hpp"
+
+namespace picpic {
+
+class CompareView : public QWidget {
+    Q_OBJECT
+public:
+    static constexpr int kMaxPictures = 4;
+
+    CompareView(PixmapCache* cache, QWidget* parent = nullptr);
+    void setImagePaths(
+        const QStringList& paths, const QVector<int>& rotations);
+    void preload(const QStringList& paths, const QVector<int>& rotations);
+
+private:
+    void onViewChanged(ImageViewer* source, qreal zoom, QPointF center);
+
+    QVector<ImageViewer*> panes_;
+    int nr_visible_{0};
+};
+
+} // picpic
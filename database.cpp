@@ -0,0 +1,366 @@
+#include "database.hpp"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+
+namespace picpic {
+
+namespace {
+
+constexpr const char* kPicturesConnectionName = "pictures";
+constexpr const char* kWorkerConnectionName = "worker_%1_%2";
+constexpr const char* kCheckConnectionName = "check_%1";
+// The index builds of a Migrator hold the write lock for minutes on large
+// libraries, the jobs writing meanwhile wait for it instead of failing
+// after the 5 s of QSQLITE
+constexpr int kWorkerBusyTimeoutMs = 10 * 60 * 1000;
+constexpr const char* kPicturesTableCreationQuery =
+    "create table if not exists %1.pictures ("
+    "id integer primary key, "
+    "path varchar(4096) unique, "
+    "rating tinyint, "
+    "rotation tinyint default 0"
+    ")";
+constexpr const char* kPicturesRotationColumn = "rotation";
+constexpr const char* kPicturesAddRotationQuery =
+    "alter table %1.pictures add column rotation tinyint default 0";
+constexpr const char* kPicturesRatingIndexQuery =
+    "create index if not exists %1.pictures_rating on pictures (rating)";
+constexpr const char* kPicturesAddColumnQuery =
+    "alter table %1.pictures add column %2 %3";
+// see PictureMetrics
+constexpr const char* kPicturesMetricsColumns[][2] = {
+    {"sharpness", "real"},
+    {"clipped", "real"},
+    {"histogram", "blob"},
+};
+constexpr const char* kPicturesSharpnessIndexQuery =
+    "create index if not exists %1.pictures_sharpness on pictures (sharpness)";
+
+bool hasColumn(QSqlQuery& query, const QString& schema, const char* column)
+{
+    query.exec(QString("pragma %1.table_info(%2)").arg(schema, kPicturesTable));
+    bool found = false;
+    while (query.next()) {
+        found |= query.value(1).toString() == column;
+    }
+    return found;
+}
+
+// Migrations are applied in order, the user_version of a library is the
+// number of them applied. They are all idempotent: libraries from before
+// the versioning have user_version 0, and the ones running in the
+// background may be skipped by openPicDatabase which goes on with the next.
+struct Migration {
+    const char* description;
+    // index builds, which may take minutes on large libraries
+    bool background;
+    bool (*apply)(QSqlQuery& query, const QString& schema);
+};
+
+const Migration kMigrations[] = {
+    {"creating the pictures table",
+     false,
+     [](QSqlQuery& query, const QString& schema) {
+         return query.exec(QString(kPicturesTableCreationQuery).arg(schema));
+     }},
+    {"adding rotations",
+     false,
+     [](QSqlQuery& query, const QString& schema) {
+         return hasColumn(query, schema, kPicturesRotationColumn)
+                || query.exec(QString(kPicturesAddRotationQuery).arg(schema));
+     }},
+    {"indexing ratings",
+     true,
+     [](QSqlQuery& query, const QString& schema) {
+         return query.exec(QString(kPicturesRatingIndexQuery).arg(schema));
+     }},
+    {"adding quality metrics",
+     false,
+     [](QSqlQuery& query, const QString& schema) {
+         for (const auto& column : kPicturesMetricsColumns) {
+             if (!hasColumn(query, schema, column[0])
+                 && !query.exec(QString(kPicturesAddColumnQuery)
+                                    .arg(schema, column[0], column[1]))) {
+                 return false;
+             }
+         }
+         return true;
+     }},
+    {"indexing sharpness",
+     true,
+     [](QSqlQuery& query, const QString& schema) {
+         return query.exec(QString(kPicturesSharpnessIndexQuery).arg(schema));
+     }},
+};
+constexpr int kNrMigrations = sizeof(kMigrations) / sizeof(kMigrations[0]);
+
+// WAL lets readers and one writer use the library at once. It is stored in
+// the file, synchronous is per connection: with WAL, NORMAL cannot corrupt
+// the library, the last transactions may only be lost on power loss.
+void configureConnection(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("pragma journal_mode = wal")
+        || !query.exec("pragma synchronous = normal")) {
+        qDebug() << "failed to enable WAL:" << query.lastError().text();
+    }
+}
+
+int userVersion(QSqlQuery& query, const QString& schema)
+{
+    query.exec(QString("pragma %1.user_version").arg(schema));
+    return query.next() ? query.value(0).toInt() : 0;
+}
+
+constexpr const char* kMainSchema = "main";
+constexpr const char* kAttachedSchema = "library%1";
+
+QString librarySchema(int library)
+{
+    return library == 0 ? QString(kMainSchema)
+                        : QString(kAttachedSchema).arg(library);
+}
+
+int nrLibraries(QSqlDatabase db)
+{
+    return libraryFiles(db).size();
+}
+
+// The view is rebuilt with all the libraries. The filters of the queries
+// are pushed down to each library and sorted results are merged by SQLite.
+bool createAllPicturesView(QSqlDatabase db)
+{
+    QStringList selects;
+    for (int library = 0; library < nrLibraries(db); ++library) {
+        selects.push_back(
+            QString("select id * %1 + %2 as id, path, rating, rotation, "
+                    "sharpness, clipped from %3.%4")
+                .arg(kMaxLibraries)
+                .arg(library)
+                .arg(librarySchema(library), kPicturesTable));
+    }
+
+    QSqlQuery query(db);
+    QString drop = QString("drop view if exists temp.%1").arg(kAllPicturesView);
+    QString create = QString("create temp view %1 as %2")
+                         .arg(kAllPicturesView, selects.join(" union all "));
+    if (!query.exec(drop) || !query.exec(create)) {
+        qDebug() << "failed to create the view of all libraries:"
+                 << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+} // <anonymous>
+
+QSqlDatabase openPicDatabase(const QString& path)
+{
+    if (QSqlDatabase::contains(kPicturesConnectionName)) {
+        QSqlDatabase::removeDatabase(kPicturesConnectionName);
+    }
+
+    QSqlDatabase db =
+        QSqlDatabase::addDatabase("QSQLITE", kPicturesConnectionName);
+    db.setDatabaseName(path);
+    if (db.open()) {
+        configureConnection(db);
+        migratePicDatabase(db, kMainSchema, false);
+    }
+    return db;
+}
+
+QSqlDatabase openWorkerDatabase(const QString& path)
+{
+    // connections can only be used by the thread which opened them
+    const QString name =
+        QString(kWorkerConnectionName)
+            .arg(reinterpret_cast<quintptr>(QThread::currentThread()))
+            .arg(path);
+    if (QSqlDatabase::contains(name)) {
+        return QSqlDatabase::database(name);
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(path);
+    db.setConnectOptions(
+        QString("QSQLITE_BUSY_TIMEOUT=%1").arg(kWorkerBusyTimeoutMs));
+    if (db.open()) {
+        configureConnection(db);
+    }
+    else {
+        qDebug() << "failed to open" << path << ":" << db.lastError().text();
+    }
+    return db;
+}
+
+void closeWorkerDatabases()
+{
+    const QString prefix =
+        QString(kWorkerConnectionName)
+            .arg(reinterpret_cast<quintptr>(QThread::currentThread()))
+            .arg(QString());
+    for (const auto& name : QSqlDatabase::connectionNames()) {
+        if (name.startsWith(prefix)) {
+            QSqlDatabase::removeDatabase(name);
+        }
+    }
+}
+
+bool migratePicDatabase(
+    QSqlDatabase db,
+    const QString& schema,
+    bool background,
+    const MigrationProgress& progress)
+{
+    QSqlQuery query(db);
+    int version = userVersion(query, schema);
+    // only the migrations applied in order are counted
+    bool in_order = true;
+    for (int step = version; step < kNrMigrations; ++step) {
+        const Migration& migration = kMigrations[step];
+        if (migration.background && !background) {
+            in_order = false;
+            continue;
+        }
+        if (progress) {
+            progress(
+                step - version,
+                kNrMigrations - version,
+                migration.description);
+        }
+
+        db.transaction();
+        bool success = migration.apply(query, schema);
+        if (success && in_order) {
+            success = query.exec(QString("pragma %1.user_version = %2")
+                                     .arg(schema)
+                                     .arg(step + 1));
+        }
+        if (!success) {
+            qDebug() << "failed" << migration.description << ":"
+                     << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+        db.commit();
+    }
+    return true;
+}
+
+bool attachLibrary(QSqlDatabase db, const QString& path, bool upgrade)
+{
+    if (isLibraryFile(db, path)) {
+        qDebug() << path << "is open already";
+        return false;
+    }
+    int library = nrLibraries(db);
+    if (library >= kMaxLibraries) {
+        qDebug() << "cannot attach more than" << kMaxLibraries << "libraries";
+        return false;
+    }
+
+    QString schema = librarySchema(library);
+    QSqlQuery query(db);
+    query.prepare(QString("attach database ? as %1").arg(schema));
+    query.addBindValue(path);
+    if (!query.exec()) {
+        qDebug() << "failed to attach" << path << ":"
+                 << query.lastError().text();
+        return false;
+    }
+
+    // only libraries are attached, not any SQLite file
+    QSqlQuery tables(db);
+    tables.exec(QString("select name from %1.sqlite_master "
+                        "where type = 'table' and name = '%2'")
+                    .arg(schema, kPicturesTable));
+    bool has_table = tables.next();
+    tables.finish();
+    if (!has_table) {
+        qDebug() << path << "is not a library";
+        query.exec(QString("detach database %1").arg(schema));
+        return false;
+    }
+    if (!upgrade) {
+        bool upgraded = userVersion(query, schema) >= kNrMigrations;
+        query.finish();
+        if (!upgraded) {
+            qDebug() << path << "must be upgraded";
+            query.exec(QString("detach database %1").arg(schema));
+            return false;
+        }
+    }
+    // the indexes are built by a Migrator
+    return migratePicDatabase(db, schema, false) && createAllPicturesView(db);
+}
+
+bool libraryNeedsUpgrade(const QString& path)
+{
+    // a connection of its own, the libraries of the view are not touched
+    const QString connection = QString(kCheckConnectionName)
+                                   .arg(reinterpret_cast<quintptr>(
+                                       QThread::currentThread()));
+    bool needs_upgrade = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection);
+        db.setDatabaseName(path);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        if (db.open()) {
+            QSqlQuery query(db);
+            needs_upgrade = userVersion(query, kMainSchema) < kNrMigrations;
+        }
+    }
+    QSqlDatabase::removeDatabase(connection);
+    return needs_upgrade;
+}
+
+bool isLibraryFile(QSqlDatabase db, const QString& path)
+{
+    const QString file = QFileInfo(path).canonicalFilePath();
+    if (file.isEmpty()) {
+        return false;
+    }
+    for (const auto& library : libraryFiles(db)) {
+        if (QFileInfo(library).canonicalFilePath() == file) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QStringList libraryFiles(QSqlDatabase db)
+{
+    QStringList files;
+    QSqlQuery query(db);
+    query.exec("pragma database_list");
+    while (query.next()) {
+        // the temp schema holds the view
+        if (query.value(1).toString() != "temp") {
+            files.push_back(query.value(2).toString());
+        }
+    }
+    return files;
+}
+
+int libraryIndex(int view_id)
+{
+    return view_id % kMaxLibraries;
+}
+
+QString libraryTable(int view_id)
+{
+    return librarySchema(libraryIndex(view_id)) + '.' + kPicturesTable;
+}
+
+int libraryId(int view_id)
+{
+    return view_id / kMaxLibraries;
+}
+
+} // picpic
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+
+#include <QSqlDatabase>
+#include <QString>
+
+namespace picpic {
+
+constexpr const char* kPicturesTable = "pictures";
+
+// Open the library at path, creating it if needed. Its schema is migrated
+// but for the index builds, see Migrator.
+QSqlDatabase openPicDatabase(const QString& path);
+
+// Connection of the calling thread to the library at path, opened on first
+// use. Libraries are in WAL mode: the GUI thread reads them while a worker
+// thread writes. closeWorkerDatabases() closes the connections of the
+// calling thread.
+QSqlDatabase openWorkerDatabase(const QString& path);
+void closeWorkerDatabases();
+
+using MigrationProgress = std::function<void(
+    int step, int nr_steps, const QString& description)>;
+
+// Apply the pending schema migrations of the library attached as schema,
+// "main" for the one opened. Index builds are only applied when background
+// is set, they may take minutes on large libraries.
+bool migratePicDatabase(
+    QSqlDatabase db,
+    const QString& schema,
+    bool background,
+    const MigrationProgress& progress = {});
+
+// Other libraries can be attached to the one opened, their pictures are
+// browsed together through the kAllPicturesView view. Its ids encode the
+// library of each picture: id * kMaxLibraries + library, the library
+// opened being 0.
+constexpr const char* kAllPicturesView = "all_pictures";
+constexpr int kMaxLibraries = 16;
+
+// Attach the library at path, unless it is one of the libraries of db
+// already. Libraries made by an older version are only attached when
+// upgrade is set: they are migrated then, but for the index builds, see
+// Migrator. Attaching a library to browse it does not change it otherwise.
+bool attachLibrary(QSqlDatabase db, const QString& path, bool upgrade);
+// The library at path has migrations pending, it must be upgraded to be
+// attached
+bool libraryNeedsUpgrade(const QString& path);
+// Files of the libraries of the view, the library opened first
+QStringList libraryFiles(QSqlDatabase db);
+// path is the file of one of the libraries of db
+bool isLibraryFile(QSqlDatabase db, const QString& path);
+// Library holding the picture of an id of the view, its table, and the id
+// of the picture there
+int libraryIndex(int view_id);
+QString libraryTable(int view_id);
+int libraryId(int view_id);
+
+} // picpic
@@ -1,47 +1,50 @@
 #include "deleter.hpp"
 
-namespace picpic {
-namespace {
+#include <QSqlError>
+#include <QSqlQuery>
 
-constexpr int kBatchSize = 1000;
+#include "database.hpp"
+#include "trace.hpp"
 
-}
+namespace picpic {
 
-Deleter::Deleter(PicModel* model, const QVector<int>& rows, QObject* parent)
-    : QObject(parent), model_{model}
+Deleter::Deleter(QSqlDatabase db, const Selection& selection)
+    : Job(selection.size() < 0
+              ? QString("Delete pictures")
+              : QString("Delete %1 pictures").arg(selection.size()),
+          Resource::kDatabase),
+      cursor_{db, selection},
+      size_{selection.size()}
 {
-    connect(this, &Deleter::next, this, &Deleter::onNext, Qt::QueuedConnection);
-
-    std::transform(
-        rows.begin(), rows.end(), std::back_inserter(ids_), [this](int row) {
-            return QString::number(
-                model_->data(model_->index(row, PicModel::kColId)).toInt());
-        });
-
-    it_ = ids_.begin();
-    next();
 }
 
-void Deleter::onNext()
+Deleter::Step Deleter::step()
 {
-    progress(std::distance(ids_.begin(), it_));
-
-    if (it_ == ids_.end()) {
-        done(success_);
-        return;
+    progress(nr_deleted_, size_);
+
+    QString library;
+    QVector<int> ids;
+    QStringList paths;
+    if (!cursor_.next(&library, &ids, &paths)) {
+        if (!cursor_.errorString().isEmpty()) {
+            error_ = cursor_.errorString();
+            return Step::kFailed;
+        }
+        return success_ ? Step::kDone : Step::kFailed;
     }
 
-    QStringList ids;
-    auto end = std::min(it_ + kBatchSize, ids_.end());
-    ids.reserve(end - it_);
-    std::move(it_, end, std::back_inserter(ids));
-    it_ = end;
-
-    QSqlQuery query(model_->database());
-    success_ &= query.exec(QString("DELETE FROM %1 WHERE id IN (%2)")
-                               .arg(model_->tableName(), ids.join(',')));
-
-    next();
+    TraceScope trace{"Deleter::step"};
+    QSqlQuery query(openWorkerDatabase(library));
+    if (!query.exec(QString("DELETE FROM %1 WHERE id IN (%2)")
+                        .arg(kPicturesTable, joinIds(ids)))) {
+        success_ = false;
+        error_ = query.lastError().text();
+    }
+    else {
+        addToCounter(Counter::kDeletedRows, ids.size());
+    }
+    nr_deleted_ += ids.size();
+    return Step::kContinue;
 }
 
 } // picpic
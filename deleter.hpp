@@ -1,28 +1,28 @@
 #pragma once
 
-#include <QObject>
+#include <QSqlDatabase>
 
-#include "pic_model.hpp"
+#include "jobs.hpp"
+#include "selection.hpp"
 
 namespace picpic {
 
-class Deleter : public QObject {
+// Removes pictures from their library, on the database thread of the
+// scheduler with its own connection
+class Deleter : public Job {
     Q_OBJECT
 public:
-    Deleter(PicModel* model, const QVector<int>& rows, QObject* parent = nullptr);
-    void onNext();
+    Deleter(QSqlDatabase db, const Selection& selection);
+    const QString& errorString() const { return error_; }
 
-signals:
-    void done(bool success);
-    void progress(int row);
-
-    // private signal
-    void next();
+protected:
+    Step step() override;
 
 private:
-    PicModel* model_;
-    QStringList ids_;
-    QStringList::iterator it_;
+    SelectionCursor cursor_;
+    const int size_;
+    int nr_deleted_{0};
+    QString error_;
     bool success_{true};
 };
 
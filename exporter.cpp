@@ -4,39 +4,52 @@
 #include <QFile>
 #include <QFileInfo>
 
+#include "logging.hpp"
+#include "trace.hpp"
+
 namespace picpic {
 
-Exporter::Exporter(QString dst_dir, QVector<QString> srcs, QObject* parent)
-    : QThread(parent), dst_dir_{std::move(dst_dir)}, srcs_{std::move(srcs)}
+Exporter::Exporter(
+    QString dst_dir, QSqlDatabase db, const Selection& selection)
+    : Job("Export to " + dst_dir, Resource::kDisk),
+      dst_dir_{std::move(dst_dir)},
+      size_{selection.size()}
 {
+    addUpstream(new SelectionReader(db, selection, &srcs_));
 }
 
-void Exporter::run()
+Exporter::Step Exporter::step()
 {
-    int count = 0;
-    int copied = 0;
-    for (const auto& src : srcs_) {
-        progress(count++);
-        QFile from{src};
-        QFile to{dst_dir_ + '/' + QFileInfo(src).fileName()};
-
-        if (to.exists()) {
-            qDebug() << to.fileName() << "already exists";
-            continue;
+    progress(nr_files_, size_);
+    QStringList srcs = srcs_.take(1);
+    if (srcs.isEmpty()) {
+        if (!srcs_.isDone()) {
+            return Step::kWait;
         }
+        qDebug() << "copied" << copied_ << "/" << nr_files_;
+        return copied_ == nr_files_ ? Step::kDone : Step::kFailed;
+    }
 
-        from.copy(to.fileName());
-        if (from.error()) {
-            qDebug() << "failed to copy" << src << ":" << from.errorString();
-        }
-        else {
-            ++copied;
-        }
+    TraceScope trace{"Exporter::copy"};
+    const QString& src = srcs.front();
+    ++nr_files_;
+    QFile from{src};
+    QFile to{dst_dir_ + '/' + QFileInfo(src).fileName()};
+
+    if (to.exists()) {
+        qCDebug(lcLibrary) << to.fileName() << "already exists";
+        return Step::kContinue;
     }
 
-    qDebug() << "copied" << copied << "/" << count;
-    progress(count);
-    done(copied);
+    from.copy(to.fileName());
+    if (from.error()) {
+        qDebug() << "failed to copy" << src << ":" << from.errorString();
+    }
+    else {
+        addToCounter(Counter::kExportedBytes, from.size());
+        ++copied_;
+    }
+    return Step::kContinue;
 }
 
 } // picpic
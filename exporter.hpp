@@ -1,27 +1,32 @@
 #pragma once
 
-#include <QThread>
-#include <QVector>
+#include <QSqlDatabase>
+
+#include "jobs.hpp"
+#include "selection.hpp"
 
 namespace picpic {
 
-class Exporter : public QThread {
+// Copies pictures to a directory, the ones already there are skipped. It
+// fails unless all are copied.
+class Exporter : public Job {
     Q_OBJECT
-signals:
-    void progress(int);
-    void done(int);
-
 public:
-    Exporter(QString dst_dir, QVector<QString> srcs, QObject* parent = nullptr);
-    int nrFiles() const { return srcs_.size(); }
+    // The paths are read from the libraries by a SelectionReader stage
+    Exporter(QString dst_dir, QSqlDatabase db, const Selection& selection);
+    int nrFiles() const { return nr_files_; }
+    int nrCopied() const { return copied_; }
     const QString& dst() const { return dst_dir_; }
 
 protected:
-    void run() override;
+    Step step() override;
 
 private:
     const QString dst_dir_;
-    const QVector<QString> srcs_;
+    PathQueue srcs_{this};
+    const int size_;
+    int nr_files_{0};
+    int copied_{0};
 };
 
 } // picpic
@@ -1,30 +1,70 @@
 #include "file_scanner.hpp"
 
-#include <QDebug>
 #include <QDir>
-#include <QDirIterator>
-#include <QRegularExpression>
+
+#include "logging.hpp"
+#include "trace.hpp"
+#include "video.hpp"
+#include "xmp.hpp"
 
 namespace picpic {
 
-FileScanner::FileScanner(QString dir, QObject* parent)
-    : QThread(parent), root_{std::move(dir)}
+namespace {
+
+// entries listed between two cancellation checks
+constexpr int kEntriesPerStep = 256;
+
+// Camera RAW files are shown through their embedded preview, video clips
+// through their first keyframe, when they can be decoded. Anchored at the
+// end of the path so that sidecars such as IMG_1.jpg.xmp are not taken for
+// pictures.
+QString scannedPattern()
+{
+    QString suffixes = "jpg|jpeg|png|bmp|gif|cr2|nef|arw|dng";
+    if (hasVideoBackend()) {
+        suffixes += "|mov|mp4|m4v|3gp";
+    }
+    return QString("\\.(%1)\\z").arg(suffixes);
+}
+
+} // <anonymous>
+
+FileScanner::FileScanner(QString dir, RatedPathQueue* output)
+    : Job("Scan " + dir, Resource::kDisk),
+      root_{std::move(dir)},
+      output_{output},
+      regex_{scannedPattern(), QRegularExpression::CaseInsensitiveOption}
 {
 }
 
-void FileScanner::run()
+FileScanner::Step FileScanner::step()
 {
-    QRegularExpression regex{".*\\.(jpg|jpeg|png|bmp|gif)"};
-    QDirIterator it(root_, QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QString path = it.next();
-        if (!regex.match(path).hasMatch()) {
+    TraceScope trace{"FileScanner::step"};
+    if (!it_) {
+        it_ = std::make_unique<QDirIterator>(
+            root_, QDir::Files, QDirIterator::Subdirectories);
+    }
+
+    QList<RatedPath> pictures;
+    for (int i = 0; i < kEntriesPerStep && it_->hasNext(); ++i) {
+        QString path = it_->next();
+        if (!regex_.match(path).hasMatch()) {
             continue;
         }
-        qDebug() << "new file:" << path;
-        newFile(path);
+        qCDebug(lcLibrary) << "new file:" << path;
+        int rating = readSidecarRating(path);
+        pictures.push_back({std::move(path), rating});
+    }
+    addToCounter(Counter::kScannedFiles, pictures.size());
+    nr_files_ += pictures.size();
+    output_->push(pictures);
+    progress(nr_files_, -1);
+
+    if (it_->hasNext()) {
+        return Step::kContinue;
     }
-    done();
+    output_->close();
+    return Step::kDone;
 }
 
 } // picpic
@@ -1,23 +1,31 @@
 #pragma once
 
-#include <QThread>
+#include <memory>
+
+#include <QDirIterator>
+#include <QRegularExpression>
+
+#include "jobs.hpp"
 
 namespace picpic {
 
-class FileScanner : public QThread {
+// First stage of the scans: the pictures found under dir are pushed to
+// output, which is closed once they all are. Their rating is read from
+// their XMP sidecar when they have one.
+class FileScanner : public Job {
     Q_OBJECT
 public:
-    FileScanner(QString dir, QObject* parent = nullptr);
-
-signals:
-    void newFile(QString path);
-    void done();
+    FileScanner(QString dir, RatedPathQueue* output);
 
 protected:
-    void run() override;
+    Step step() override;
 
 private:
-    QString root_;
+    const QString root_;
+    RatedPathQueue* output_;
+    std::unique_ptr<QDirIterator> it_;
+    QRegularExpression regex_;
+    int nr_files_{0};
 };
 
 } // picpic
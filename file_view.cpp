@@ -1,6 +1,8 @@
 #include "file_view.hpp"
 #include "pic_model.hpp"
 
+#include <algorithm>
+
 #include <QHeaderView>
 #include <QMessageBox>
 
@@ -20,18 +22,77 @@ void FileView::setModel(QAbstractItemModel* model)
     horizontalHeader()->setSectionResizeMode(
         PicModel::kColPath, QHeaderView::Stretch);
     setColumnHidden(PicModel::kColId, true);
+    setColumnHidden(PicModel::kColRotation, true);
     sortByColumn(PicModel::kColPath, Qt::AscendingOrder);
     setTextElideMode(Qt::ElideLeft);
     setWordWrap(false);
 }
 
-QVector<int> FileView::selectedRows() const
+void FileView::paintEvent(QPaintEvent* event)
+{
+    // thumbnails of the visible rows are requested while painting them
+    QTableView::paintEvent(event);
+
+    PicModel* pic_model = qobject_cast<PicModel*>(model());
+    if (!pic_model) {
+        return;
+    }
+
+    int first = rowAt(0);
+    if (first < 0) {
+        return;
+    }
+    int last = rowAt(viewport()->height() - 1);
+    if (last < 0) {
+        last = pic_model->rowCount() - 1;
+    }
+    pic_model->setVisibleRows(first, last);
+}
+
+QVector<QPair<int, int>> FileView::selectedRanges() const
+{
+    QVector<QPair<int, int>> ranges;
+    if (!selectionModel()) {
+        return ranges;
+    }
+    // the ranges of a selection may overlap
+    for (const auto& range : selectionModel()->selection()) {
+        ranges.push_back({range.top(), range.bottom()});
+    }
+    std::sort(ranges.begin(), ranges.end());
+
+    QVector<QPair<int, int>> merged;
+    for (const auto& range : ranges) {
+        if (!merged.isEmpty() && range.first <= merged.back().second + 1) {
+            merged.back().second =
+                std::max(merged.back().second, range.second);
+        }
+        else {
+            merged.push_back(range);
+        }
+    }
+    return merged;
+}
+
+int FileView::nrSelectedRows() const
+{
+    int nr_rows = 0;
+    for (const auto& range : selectedRanges()) {
+        nr_rows += range.second - range.first + 1;
+    }
+    return nr_rows;
+}
+
+QVector<int> FileView::selectedRows(int max) const
 {
-    auto selected_rows = selectionModel()->selectedRows();
     QVector<int> rows;
-    rows.reserve(selected_rows.size());
-    for (const auto& select : selected_rows) {
-        rows.push_back(select.row());
+    for (const auto& range : selectedRanges()) {
+        for (int row = range.first; row <= range.second; ++row) {
+            if (rows.size() == max) {
+                return rows;
+            }
+            rows.push_back(row);
+        }
     }
     return rows;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <limits>
+
+#include <QPair>
 #include <QTableView>
 
 namespace picpic {
@@ -9,7 +12,16 @@ class FileView : public QTableView {
 public:
     FileView(QWidget* parent = nullptr);
     void setModel(QAbstractItemModel* model) override;
-    QVector<int> selectedRows() const;
+    // Selected rows as sorted and disjoint [first, last] ranges, without
+    // listing them: a selection of all the rows is a single range
+    QVector<QPair<int, int>> selectedRanges() const;
+    int nrSelectedRows() const;
+    // The first max selected rows, in order
+    QVector<int> selectedRows(
+        int max = std::numeric_limits<int>::max()) const;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
 };
 
 } // picpic
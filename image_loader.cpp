@@ -1,63 +1,383 @@
 #include "image_loader.hpp"
 
-#include <QDebug>
+#include <algorithm>
+
+#include <QBuffer>
 #include <QImage>
 #include <QImageReader>
-#include <QPixmap>
+#include <QSet>
+#include <QTransform>
+
+#include "color.hpp"
+#include "logging.hpp"
+#include "mapped_file.hpp"
+#include "prefetcher.hpp"
+#include "preview.hpp"
+#include "resample.hpp"
+#include "thumbnail_cache.hpp"
+#include "trace.hpp"
+#include "video.hpp"
 
 namespace picpic {
 
+namespace {
+
+constexpr int kPreviewReduction = 8;
+
+// Let the decoder scale the picture (JPEG DCT scaling) to fit in bound
+// instead of decoding it at full resolution. The bound applies after the
+// orientation, which transposes the picture or not.
+QImage decode(QImageReader& reader, QSize bound, bool transposed)
+{
+    if (bound.isValid() && reader.size().isValid()) {
+        if (transposed) {
+            bound.transpose();
+        }
+        QSize target = reader.size().scaled(bound, Qt::KeepAspectRatio);
+        if (target.width() < reader.size().width()) {
+            reader.setScaledSize(target);
+        }
+    }
+    // converted before it is resampled or cached, on the loader thread
+    QImage image = reader.read();
+    convertToDisplayColorSpace(image);
+    return image;
+}
+
+// The file is mapped and decoded in place, the pages are read ahead by the
+// kernel instead of being copied through read() calls. drop_from_cache is
+// for files that will not be read again soon, thumbnails once cached.
+QImage decode(const QString& path, QSize bound, bool drop_from_cache = false)
+{
+    TraceScope trace{kDecodeTrace};
+    addToCounter(Counter::kDecodes);
+
+    // only the start of the clip is read, it is not mapped whole
+    if (isVideoFile(path)) {
+        return decodeVideoKeyframe(path, bound);
+    }
+
+    MappedFile file{path};
+    file.adviseSequential();
+    file.setDropFromCache(drop_from_cache);
+
+    // without a mapping or a preview, the file is left to the image
+    // plugins below, which may read RAW files themselves
+    if (isRawFile(path) && file.isMapped()) {
+        RawPreview raw{file};
+        if (raw.isValid()) {
+            QByteArray jpeg = raw.jpeg();
+            QBuffer buffer{&jpeg};
+            buffer.open(QIODevice::ReadOnly);
+            QImageReader reader{&buffer, "jpeg"};
+            // the orientation of the RAW file applies, not the preview's own
+            reader.setAutoTransform(false);
+            int orientation = raw.orientation();
+            QImage image = applyOrientation(
+                decode(reader, bound, isTransposed(orientation)), orientation);
+            if (!image.isNull()) {
+                return image;
+            }
+            qCDebug(lcLoader) << "cannot decode the preview of" << path;
+        }
+    }
+
+    QByteArray bytes = file.bytes();
+    QBuffer buffer{&bytes};
+    buffer.open(QIODevice::ReadOnly);
+    // the format is found from the content when reading from a buffer
+    QImageReader reader;
+    if (file.isMapped()) {
+        reader.setDevice(&buffer);
+    }
+    else {
+        reader.setFileName(path);
+    }
+    reader.setAutoTransform(true);
+    return decode(
+        reader,
+        bound,
+        reader.transformation() & QImageIOHandler::TransformationRotate90);
+}
+
+// Size of the picture once oriented, without decoding it
+QSize displayedSize(const QString& path)
+{
+    QSize size;
+    bool transposed = false;
+    if (isRawFile(path)) {
+        MappedFile file{path};
+        RawPreview raw{file};
+        size = raw.size();
+        transposed = isTransposed(raw.orientation());
+    }
+    if (!size.isValid()) {
+        QImageReader reader{path};
+        reader.setAutoTransform(true);
+        size = reader.size();
+        transposed =
+            reader.transformation() & QImageIOHandler::TransformationRotate90;
+    }
+    if (transposed) {
+        size.transpose();
+    }
+    return size;
+}
+
+QImage decodePreview(const QString& path, QSize bound)
+{
+    // a keyframe is all that is ever decoded of a clip
+    if (isVideoFile(path)) {
+        return decode(path, bound);
+    }
+
+    QImage preview = loadEmbeddedPreview(path);
+    if (!preview.isNull()) {
+        return preview;
+    }
+
+    // JPEG decoders skip most of the work at 1/8 scale
+    QSize reduced = displayedSize(path) / kPreviewReduction;
+    if (reduced.isEmpty()) {
+        return decode(path, bound);
+    }
+    return decode(path, bound.isValid() ? reduced.boundedTo(bound) : reduced);
+}
+
+bool fits(QSize size, QSize bound)
+{
+    return size.width() <= bound.width() && size.height() <= bound.height();
+}
+
+} // <anonymous>
+
 ImageLoader::ImageLoader(int size, QObject* parent)
     : QThread(parent), size_{size}
 {
+    qRegisterMetaType<PictureMetrics>();
 }
 
 ImageLoader::~ImageLoader()
 {
     requestInterruption();
-    cv_.notify_all();
+    {
+        std::lock_guard lock{mutex_};
+        cv_.notify_all();
+    }
     wait();
+
+    // nothing is emitted anymore, the receivers may be destroyed already
+    int nr_requests = requests_.size();
+    Node* node = incoming_.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+        nr_requests += node->cancel ? 0 : 1;
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+    addToCounter(Counter::kLoaderQueueDepth, -nr_requests);
+}
+
+void ImageLoader::setPrefetchEnabled(bool enabled)
+{
+    if (!enabled) {
+        prefetcher_.reset();
+        return;
+    }
+    // cached thumbnails are read instead of the pictures, and reading
+    // video clips whole would delay the pictures queued after them
+    // it never holds more files than the queue of requests
+    prefetcher_ = std::make_unique<Prefetcher>(
+        [this](const QString& path) {
+            return !isVideoFile(path)
+                   && (!thumbnail_cache_ || !hasCachedThumbnail(path));
+        },
+        size_);
+}
+
+void ImageLoader::load(const QString& path, QSize size, int rotation, int id)
+{
+    addToCounter(Counter::kLoaderQueueDepth);
+    push(new Node{Request{path, size, rotation, id}, {}});
+}
+
+void ImageLoader::cancel(std::function<bool(int id)> predicate)
+{
+    push(new Node{Request{}, std::move(predicate)});
+}
+
+void ImageLoader::push(Node* node)
+{
+    node->next = incoming_.load(std::memory_order_relaxed);
+    while (!incoming_.compare_exchange_weak(
+        node->next,
+        node,
+        std::memory_order_release,
+        std::memory_order_relaxed)) {
+    }
+    wake();
+}
+
+void ImageLoader::wake()
+{
+    // Either the decoding thread sees the pushed node before sleeping, or
+    // this sees sleeping_ set and notifies, see waitForNodes
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard lock{mutex_};
+        cv_.notify_one();
+    }
 }
 
-void ImageLoader::load(const QString& path, QSize size)
+void ImageLoader::waitForNodes()
 {
     std::unique_lock lock{mutex_};
-    requests_.push_back(Request{path, size});
-    while (size_ > 0 && requests_.size() > size_) {
-        requests_.pop_front();
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv_.wait(lock, [this]() {
+        return incoming_.load(std::memory_order_relaxed)
+               || isInterruptionRequested();
+    });
+    sleeping_.store(false, std::memory_order_relaxed);
+}
+
+void ImageLoader::takeNodes()
+{
+    // the stack is in reverse order of the calls
+    Node* node = incoming_.exchange(nullptr, std::memory_order_acquire);
+    Node* reversed = nullptr;
+    while (node) {
+        Node* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+
+    QList<Request> dropped;
+    QSet<QString> added;
+    for (node = reversed; node;) {
+        if (node->cancel) {
+            // what was queued by the previous batches is not read ahead
+            // again, the requests of this one are read ahead below
+            if (prefetcher_) {
+                prefetcher_->clear();
+            }
+            auto end = std::remove_if(
+                requests_.begin(), requests_.end(), [&](const Request& req) {
+                    return node->cancel(req.id);
+                });
+            addToCounter(Counter::kLoaderQueueDepth, end - requests_.end());
+            requests_.erase(end, requests_.end());
+        }
+        else {
+            // the latest request for a path wins
+            auto it = std::find_if(
+                requests_.begin(), requests_.end(), [&](const Request& req) {
+                    return req.path == node->request.path;
+                });
+            if (it != requests_.end()) {
+                if (it->id != node->request.id) {
+                    dropped.push_back(*it);
+                }
+                requests_.erase(it);
+                addToCounter(Counter::kLoaderQueueDepth, -1);
+            }
+            else {
+                added.insert(node->request.path);
+            }
+            requests_.push_back(std::move(node->request));
+            while (size_ > 0 && requests_.size() > size_) {
+                dropped.push_back(requests_.takeFirst());
+                addToCounter(Counter::kLoaderQueueDepth, -1);
+            }
+        }
+
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+
+    // the requests of this batch that were neither dropped nor cancelled
+    if (prefetcher_ && !added.isEmpty()) {
+        QStringList paths;
+        for (const Request& req : requests_) {
+            if (added.contains(req.path)) {
+                paths.push_back(req.path);
+            }
+        }
+        prefetcher_->prefetch(paths);
+    }
+    for (const Request& req : dropped) {
+        requestDropped(req.path, req.id);
     }
-    cv_.notify_all();
 }
 
 void ImageLoader::run()
 {
     while (!isInterruptionRequested()) {
-        Request req;
-        {
-            std::unique_lock lock{mutex_};
-            cv_.wait(lock, [this]() {
-                return !requests_.empty() || isInterruptionRequested();
-            });
-
-            if (requests_.empty()) {
-                continue;
-            }
+        takeNodes();
+        if (requests_.empty()) {
+            waitForNodes();
+            continue;
+        }
+
+        Request req = requests_.takeFirst();
+        addToCounter(Counter::kLoaderQueueDepth, -1);
+
+        TraceScope trace{"ImageLoader::load"};
+        qCDebug(lcLoader) << "loading" << req.path;
 
-            req = requests_.front();
-            requests_.pop_front();
+        // the bound applies after the rotation
+        QSize bound = req.size;
+        if (bound.isValid() && req.rotation % 2 != 0) {
+            bound.transpose();
         }
 
-        qDebug() << "loading" << req.path;
-        QImageReader reader{req.path};
-        reader.setAutoTransform(true);
-        QPixmap pixmap = QPixmap::fromImage(reader.read());
-        if (req.size.isValid()) {
-            pixmap = pixmap.scaled(
-                req.size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        QImage image;
+        const QSize cache_size{kThumbnailCacheSize, kThumbnailCacheSize};
+        if (preview_mode_) {
+            image = decodePreview(req.path, bound);
+        }
+        else if (
+            thumbnail_cache_ && bound.isValid() && fits(bound, cache_size)) {
+            image = loadThumbnail(req.path, drop_from_cache_);
+            if (metrics_ && !image.isNull()) {
+                metricsComputed(req.path, computeMetrics(image), req.id);
+            }
+        }
+        else {
+            image = decode(req.path, bound, drop_from_cache_);
+        }
+        // embedded previews, the decodes are converted already
+        convertToDisplayColorSpace(image);
+
+        if (bound.isValid() && !fits(image.size(), bound)) {
+            image = resample(
+                image, image.size().scaled(bound, Qt::KeepAspectRatio));
         }
-        pixmapLoaded(req.path, pixmap);
-        qDebug() << "loading" << req.path << "done";
+        if (req.rotation % 4 != 0) {
+            image = image.transformed(QTransform().rotate(90 * req.rotation));
+        }
+        imageLoaded(req.path, image, req.size, req.rotation, req.id);
+        qCDebug(lcLoader) << "loading" << req.path << "done";
+    }
+}
+
+QImage loadThumbnail(const QString& path, bool drop_from_cache)
+{
+    QImage image = loadCachedThumbnail(path);
+    if (image.isNull()) {
+        addToCounter(Counter::kThumbnailCacheMisses);
+        const QSize cache_size{kThumbnailCacheSize, kThumbnailCacheSize};
+        image = decode(path, cache_size, drop_from_cache);
+        storeCachedThumbnail(path, image);
+    }
+    else {
+        addToCounter(Counter::kThumbnailCacheHits);
+        // cached before the conversion
+        convertToDisplayColorSpace(image);
     }
+    return image;
 }
 
 } // picpic
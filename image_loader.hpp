@@ -1,25 +1,65 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <optional>
 
-#include <QLabel>
-#include <QPixmap>
+#include <QImage>
 #include <QThread>
 
+#include "metrics.hpp"
+
 namespace picpic {
 
+class Prefetcher;
+
+// Decodes pictures on its own thread. Images are handed over as QImage,
+// QPixmap may only be used on the GUI thread.
+//
+// load() and cancel() never wait for the decoding thread: they push onto a
+// lock-free stack that the decoding thread takes whole. A request for a
+// path already queued replaces the queued one.
 class ImageLoader : public QThread {
     Q_OBJECT
 signals:
-    void pixmapLoaded(QString path, QPixmap pixmap);
+    void imageLoaded(
+        QString path, QImage image, QSize size, int rotation, int id);
+    // emitted by the decoding thread when the queue is full and an old
+    // request is dropped, or when it is replaced by a request with another id
+    void requestDropped(QString path, int id);
+    // emitted before imageLoaded for the requests served from the thumbnail
+    // cache, when metrics are enabled
+    void metricsComputed(QString path, PictureMetrics metrics, int id);
 
 public:
     ImageLoader(int size = -1, QObject* parent = nullptr);
     ~ImageLoader() override;
 
-    void load(const QString& path, QSize size = {});
+    // rotation is a number of clockwise quarter turns, applied after the
+    // EXIF orientation. id is not used by the loader, it is given back with
+    // the result.
+    void load(
+        const QString& path, QSize size = {}, int rotation = 0, int id = -1);
+    // Remove the requests queued so far for which predicate(id) is true.
+    // predicate is called later on the decoding thread.
+    void cancel(std::function<bool(int id)> predicate);
+
+    // Serve small requests from the persistent thumbnail cache
+    void setThumbnailCacheEnabled(bool enabled) { thumbnail_cache_ = enabled; }
+    // Load a quick low resolution version of the pictures instead: the
+    // embedded preview, or a decode scaled down by the decoder
+    void setPreviewMode(bool enabled) { preview_mode_ = enabled; }
+    // Drop the decoded files from the page cache, for pictures that will
+    // not be loaded again soon
+    void setDropFromPageCache(bool drop) { drop_from_cache_ = drop; }
+    // Compute the metrics of the thumbnails it loads, they cost little next
+    // to the decode
+    void setMetricsEnabled(bool enabled) { metrics_ = enabled; }
+    // Read the queued files ahead on other threads, many at a time, while
+    // the decoding thread decodes. Call it before start().
+    void setPrefetchEnabled(bool enabled);
 
 protected:
     void run() override;
@@ -28,12 +68,39 @@ private:
     struct Request {
         QString path;
         QSize size;
+        int rotation{0};
+        int id{-1};
     };
+    // a request, or a cancellation when cancel is set
+    struct Node {
+        Request request;
+        std::function<bool(int id)> cancel;
+        Node* next{nullptr};
+    };
+
+    void push(Node* node);
+    void wake();
+    void waitForNodes();
+    void takeNodes();
 
+    std::atomic<Node*> incoming_{nullptr};
+    // set by the decoding thread before it sleeps, the producers only lock
+    // the mutex to wake it up
+    std::atomic<bool> sleeping_{false};
     std::mutex mutex_;
     std::condition_variable cv_;
+    // only used by the decoding thread
     QList<Request> requests_;
     int size_;
+    bool thumbnail_cache_{false};
+    bool preview_mode_{false};
+    bool drop_from_cache_{false};
+    bool metrics_{false};
+    std::unique_ptr<Prefetcher> prefetcher_;
 };
 
+// Thumbnail of the picture at path at kThumbnailCacheSize, read from the
+// thumbnail cache or decoded and then cached
+QImage loadThumbnail(const QString& path, bool drop_from_cache = false);
+
 } // picpic
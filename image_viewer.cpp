@@ -1,40 +1,106 @@
 #include "image_viewer.hpp"
 
+#include <cmath>
+#include <functional>
+
+#include <QMouseEvent>
+#include <QRunnable>
+#include <QWheelEvent>
+
+#include "resample.hpp"
+#include "trace.hpp"
+
 namespace picpic {
 namespace {
 
 constexpr int kCachedPictured = 5;
+constexpr qreal kMaxZoom = 16;
+constexpr qreal kZoomStep = 1.25;
+// resizing, zooming or browsing faster than this only scales by Qt
+constexpr int kSmoothDelayMs = 100;
+
+class ResampleRunnable : public QRunnable {
+public:
+    explicit ResampleRunnable(std::function<void()> function)
+        : function_{std::move(function)}
+    {
+    }
+
+    void run() override { function_(); }
+
+private:
+    std::function<void()> function_;
+};
 
 }
 
-ImageViewer::ImageViewer(QWidget* parent)
+ImageViewer::ImageViewer(PixmapCache* cache, QWidget* parent)
     : QLabel(parent),
-      pixmap_cache_(kCachedPictured),
+      cache_{cache},
       loader_(1),
+      preview_loader_(1),
       preloader_(kCachedPictured)
 {
     setMinimumSize(1, 1);
     setScaledContents(false);
 
+    smooth_timer_.setSingleShot(true);
+    smooth_timer_.setInterval(kSmoothDelayMs);
+    connect(&smooth_timer_, &QTimer::timeout, this, &ImageViewer::smoothPixmap);
+    smooth_pool_.setMaxThreadCount(1);
+
     connect(
         &loader_,
-        &ImageLoader::pixmapLoaded,
+        &ImageLoader::imageLoaded,
         this,
-        [this](const QString& path, const QPixmap& pixmap) {
-            pixmap_cache_.insert(path, new QPixmap(pixmap));
+        [this](
+            const QString& path,
+            const QImage& image,
+            QSize size,
+            int rotation) {
+            bool full = !size.isValid();
+            QPixmap pixmap = QPixmap::fromImage(image);
+            cache_->insert(path, rotation, pixmap, full);
+            if (path != path_ || rotation != rotation_
+                || (pixmap_full_ && !full)) {
+                return;
+            }
             pixmap_ = pixmap;
+            pixmap_full_ = full;
+            waiting_ = false;
+            updatePixmap();
+        });
+
+    // shown while the picture is being decoded, it is never cached
+    preview_loader_.setPreviewMode(true);
+    connect(
+        &preview_loader_,
+        &ImageLoader::imageLoaded,
+        this,
+        [this](const QString& path, const QImage& image, QSize, int rotation) {
+            if (!waiting_ || path != path_ || rotation != rotation_
+                || image.isNull()) {
+                return;
+            }
+            pixmap_ = QPixmap::fromImage(image);
             updatePixmap();
         });
 
     connect(
         &preloader_,
-        &ImageLoader::pixmapLoaded,
+        &ImageLoader::imageLoaded,
         this,
-        [this](const QString& path, const QPixmap& pixmap) {
-            pixmap_cache_.insert(path, new QPixmap(pixmap));
+        [this](
+            const QString& path,
+            const QImage& image,
+            QSize size,
+            int rotation) {
+            cache_->insert(
+                path, rotation, QPixmap::fromImage(image), !size.isValid());
         });
 
     loader_.start();
+    preview_loader_.start();
     preloader_.start();
 }
 
@@ -51,54 +117,223 @@ int ImageViewer::heightForWidth(int width) const
                : ((qreal)pixmap_.height() * width) / pixmap_.width();
 }
 
-void ImageViewer::rotate()
+void ImageViewer::setImagePath(const QString& path, int rotation)
 {
-    if (!pixmap_.isNull()) {
-        QMatrix m;
-        m.rotate(90);
-        pixmap_ = pixmap_.transformed(m);
+    if (waiting_ && path == path_ && rotation == rotation_) {
+        // requested again before it was decoded, it is not decoded twice
+        return;
     }
-    updatePixmap();
-}
+    path_ = path;
+    rotation_ = rotation;
+    pixmap_full_ = false;
+    full_requested_ = false;
+    waiting_ = false;
 
-void ImageViewer::setImagePath(const QString& path)
-{
-    QPixmap* cached = pixmap_cache_[path];
+    bool full = false;
+    const QPixmap* cached =
+        cache_->find(path, rotation, decodeSize(), &full);
     if (cached) {
         pixmap_ = *cached;
+        pixmap_full_ = full;
         updatePixmap();
+        loadFullIfZoomed();
         return;
     }
 
+    // the previous picture is greyed out until the preview is shown
     setEnabled(false);
-    loader_.load(path);
+    waiting_ = true;
+    loader_.load(path, decodeSize(), rotation);
+    preview_loader_.load(path, decodeSize(), rotation);
 }
 
-void ImageViewer::preload(const QString& path)
+void ImageViewer::preload(const QString& path, int rotation)
 {
-    if (pixmap_cache_[path]) {
+    if (cache_->find(path, rotation, decodeSize())) {
         return;
     }
 
-    preloader_.load(path);
+    preloader_.load(path, decodeSize(), rotation);
+}
+
+void ImageViewer::setView(qreal zoom, QPointF center)
+{
+    zoom_ = qBound<qreal>(1, zoom, kMaxZoom);
+    qreal half = 0.5 / zoom_;
+    center_.setX(qBound(half, center.x(), 1 - half));
+    center_.setY(qBound(half, center.y(), 1 - half));
+    updatePixmap();
+    loadFullIfZoomed();
+}
+
+void ImageViewer::resetView()
+{
+    setView(1, QPointF(0.5, 0.5));
+}
+
+void ImageViewer::paintEvent(QPaintEvent* event)
+{
+    QLabel::paintEvent(event);
+    if (!pixmap_.isNull()) {
+        painted(!waiting_);
+    }
 }
 
 void ImageViewer::resizeEvent(QResizeEvent*)
 {
     updatePixmap();
+
+    if (!decode_to_fit_ || pixmap_full_ || waiting_ || path_.isEmpty()
+        || pixmap_.isNull()) {
+        return;
+    }
+    QSize needed = pixmap_.size().scaled(size(), Qt::KeepAspectRatio);
+    if (needed.width() > pixmap_.width()) {
+        // the widget grew larger than the decoded picture
+        loader_.load(path_, decodeSize(), rotation_);
+    }
+}
+
+void ImageViewer::wheelEvent(QWheelEvent* event)
+{
+    if (pixmap_.isNull()) {
+        return;
+    }
+    qreal steps = event->angleDelta().y() / 120.;
+    setView(zoom_ * std::pow(kZoomStep, steps), center_);
+    viewChanged(zoom_, center_);
+}
+
+void ImageViewer::mousePressEvent(QMouseEvent* event)
+{
+    drag_pos_ = event->pos();
+}
+
+void ImageViewer::mouseMoveEvent(QMouseEvent* event)
+{
+    if (!(event->buttons() & Qt::LeftButton) || pixmap_.isNull()
+        || zoom_ <= 1) {
+        return;
+    }
+
+    QPoint delta = event->pos() - drag_pos_;
+    drag_pos_ = event->pos();
+
+    // size of the whole picture as currently displayed
+    QSizeF displayed =
+        QSizeF(pixmap_.size().scaled(size(), Qt::KeepAspectRatio)) * zoom_;
+    setView(
+        zoom_,
+        center_
+            - QPointF(
+                delta.x() / displayed.width(),
+                delta.y() / displayed.height()));
+    viewChanged(zoom_, center_);
+}
+
+void ImageViewer::mouseDoubleClickEvent(QMouseEvent*)
+{
+    resetView();
+    viewChanged(zoom_, center_);
+}
+
+QSize ImageViewer::decodeSize() const
+{
+    return decode_to_fit_ ? size() : QSize();
+}
+
+void ImageViewer::loadFullIfZoomed()
+{
+    if (zoom_ <= 1 || !decode_to_fit_ || pixmap_full_ || full_requested_
+        || path_.isEmpty()) {
+        return;
+    }
+    full_requested_ = true;
+    loader_.load(path_, {}, rotation_);
+}
+
+QRect ImageViewer::visibleRect() const
+{
+    if (zoom_ <= 1) {
+        return pixmap_.rect();
+    }
+    QSizeF src_size = QSizeF(pixmap_.size()) / zoom_;
+    QPointF src_center(
+        center_.x() * pixmap_.width(), center_.y() * pixmap_.height());
+    QRectF src(
+        src_center - QPointF(src_size.width() / 2, src_size.height() / 2),
+        src_size);
+    return src.toAlignedRect() & pixmap_.rect();
 }
 
 void ImageViewer::updatePixmap()
 {
+    TraceScope trace{"ImageViewer::updatePixmap"};
     setEnabled(true);
+    smooth_timer_.stop();
     if (pixmap_.isNull()) {
         clear();
+        return;
+    }
+
+    QRect source = visibleRect();
+    QSize target = source.size().scaled(this->size(), Qt::KeepAspectRatio);
+    if (scaled_.key == pixmap_.cacheKey() && scaled_.source == source
+        && scaled_.pixmap.size() == target) {
+        QLabel::setPixmap(scaled_.pixmap);
+        return;
+    }
+
+    QPixmap visible = source == pixmap_.rect() ? pixmap_ : pixmap_.copy(source);
+    if (target.width() < visible.width()) {
+        // resampled once the view settles, not on every step of a drag
+        QLabel::setPixmap(visible.scaled(target));
+        smooth_timer_.start();
     }
     else {
-        QPixmap scaled = pixmap_.scaled(
-            this->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-        QLabel::setPixmap(scaled);
+        QLabel::setPixmap(visible.scaled(
+            target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    }
+}
+
+void ImageViewer::smoothPixmap()
+{
+    TraceScope trace{"ImageViewer::smoothPixmap"};
+    if (pixmap_.isNull()) {
+        return;
+    }
+    QRect source = visibleRect();
+    QSize target = source.size().scaled(this->size(), Qt::KeepAspectRatio);
+    qint64 key = pixmap_.cacheKey();
+    // only the visible part of the picture is converted on the GUI thread
+    QImage visible =
+        (source == pixmap_.rect() ? pixmap_ : pixmap_.copy(source)).toImage();
+    // the resamples not started yet are for views that changed since
+    smooth_pool_.clear();
+    smooth_pool_.start(
+        new ResampleRunnable([this, visible, key, source, target] {
+            TraceScope trace{"ImageViewer::resample"};
+            QImage image = resample(visible, target);
+            QMetaObject::invokeMethod(
+                this,
+                [this, key, source, image] {
+                    showSmoothed(key, source, image);
+                },
+                Qt::QueuedConnection);
+        }));
+}
+
+void ImageViewer::showSmoothed(qint64 key, QRect source, const QImage& image)
+{
+    if (key != pixmap_.cacheKey() || source != visibleRect()
+        || image.size()
+               != source.size().scaled(this->size(), Qt::KeepAspectRatio)) {
+        return;
     }
+    scaled_.key = key;
+    scaled_.source = source;
+    scaled_.pixmap = QPixmap::fromImage(image);
+    QLabel::setPixmap(scaled_.pixmap);
 }
 
 } // picpic
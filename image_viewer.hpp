@@ -1,33 +1,84 @@
 #pragma once
 
-#include <QCache>
 #include <QLabel>
 #include <QPixmap>
+#include <QPointF>
+#include <QRect>
+#include <QThreadPool>
+#include <QTimer>
 
 #include "image_loader.hpp"
+#include "pixmap_cache.hpp"
 
 namespace picpic {
 
 class ImageViewer : public QLabel {
     Q_OBJECT
+signals:
+    void viewChanged(qreal zoom, QPointF center);
+    // after a picture was painted, decoded is false while the current one
+    // is being decoded: its preview or the previous one is shown
+    void painted(bool decoded);
+
 public:
-    ImageViewer(QWidget* parent = nullptr);
+    ImageViewer(PixmapCache* cache, QWidget* parent = nullptr);
     virtual QSize sizeHint() const override;
     virtual int heightForWidth(int width) const override;
-    void rotate();
-    void setImagePath(const QString& path);
-    void preload(const QString& path);
+    void setImagePath(const QString& path, int rotation = 0);
+    void preload(const QString& path, int rotation = 0);
+
+    // Decode pictures at the size of the widget instead of full resolution
+    void setDecodeToFit(bool enabled) { decode_to_fit_ = enabled; }
+    void setView(qreal zoom, QPointF center);
+    void resetView();
 
 protected:
+    void paintEvent(QPaintEvent* event) override;
     void resizeEvent(QResizeEvent*) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
 
 private:
+    QSize decodeSize() const;
+    void loadFullIfZoomed();
+    // Part of pixmap_ in the view
+    QRect visibleRect() const;
     void updatePixmap();
+    // Resample the visible part of pixmap_ on smooth_pool_ once the view
+    // stopped changing, it is shown scaled by Qt until then
+    void smoothPixmap();
+    // Show the resampled part of the pixmap with key, unless the view
+    // changed meanwhile
+    void showSmoothed(qint64 key, QRect source, const QImage& image);
 
+    PixmapCache* cache_;
+    QString path_;
+    int rotation_{0};
     QPixmap pixmap_;
-    QCache<QString, QPixmap> pixmap_cache_;
+    bool pixmap_full_{false};
+    // resampled from the source rect of the pixmap with cacheKey
+    struct Scaled {
+        qint64 key{0};
+        QRect source;
+        QPixmap pixmap;
+    };
+    Scaled scaled_;
+    QTimer smooth_timer_;
+    // pixmap_ is not the current picture, or only its preview
+    bool waiting_{false};
+    bool full_requested_{false};
+    bool decode_to_fit_{false};
+    qreal zoom_{1};
+    QPointF center_{0.5, 0.5};
+    QPoint drag_pos_;
     ImageLoader loader_;
+    ImageLoader preview_loader_;
     ImageLoader preloader_;
+    // a single thread, destroyed first so that its resample finishes while
+    // the viewer is whole
+    QThreadPool smooth_pool_;
 };
 
 } // picpic
@@ -1,58 +1,77 @@
 #include "inserter.hpp"
 
+#include <algorithm>
+
 #include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "database.hpp"
+#include "file_scanner.hpp"
+#include "trace.hpp"
 
 namespace picpic {
 namespace {
 
-constexpr int kBatchSize = 10;
+constexpr int kBatchSize = 100;
 
 }
 
-Inserter::Inserter(PicModel* model, const QString& path, QObject* parent)
-    : QObject(parent), model_{model}, file_scanner_{path}
+Inserter::Inserter(QSqlDatabase db, const QString& path)
+    : Job("Add " + path, Resource::kDatabase), library_{db.databaseName()}
 {
-    connect(&file_scanner_, &FileScanner::newFile, this, [this](const QString& path) {
-        pending_files_.push_back(path);
-        if (pending_files_.size() == 1) {
-            next();
-        }
-    });
-    connect(&file_scanner_, &FileScanner::done, this, [this] {
-        done_ = true;
-
-        if (pending_files_.empty()) {
-            // next won't be called
-            done(success_);
-        }
-    });
-    connect(this, &Inserter::next, this, &Inserter::onNext, Qt::QueuedConnection);
-    file_scanner_.start();
+    addUpstream(new FileScanner(path, &scanned_));
 }
 
-void Inserter::onNext()
+Inserter::Step Inserter::step()
 {
-    auto begin = pending_files_.begin();
-    auto end = std::min(begin + kBatchSize, pending_files_.end());
-
-    for (auto it = begin; it != end; ++it) {
-        bool success = model_->insert(*it);
-        if (!success) {
-            qDebug() << "inserting" << *it
-                     << "failed:" << model_->lastError().text();
+    QList<RatedPath> pictures = scanned_.take(kBatchSize);
+    if (pictures.isEmpty()) {
+        if (!scanned_.isDone()) {
+            return Step::kWait;
         }
-        success_ &= success;
+        return success_ ? Step::kDone : Step::kFailed;
     }
 
-    model_->select();
-    pending_files_.erase(begin, end);
+    TraceScope trace{"Inserter::step"};
+    // files already in the library are ignored thanks to the unique path:
+    // their rating is the one set in picpic, the ratings of the sidecars
+    // only overwrite it through an XmpImporter
+    QSqlDatabase db = openWorkerDatabase(library_);
+    QSqlQuery query(db);
+    query.prepare(
+        QString("INSERT OR IGNORE INTO %1 (path, rating, rotation) "
+                "VALUES (?, ?, 0)")
+            .arg(kPicturesTable));
 
-    if (!pending_files_.empty()) {
-        next();
+    if (!db.transaction()) {
+        qDebug() << "inserting in" << library_ << "failed:"
+                 << db.lastError().text();
+        success_ = false;
+        return Step::kContinue;
+    }
+    for (const auto& picture : pictures) {
+        query.bindValue(0, picture.path);
+        query.bindValue(1, std::max(picture.rating, 0));
+        bool success = query.exec();
+        if (!success) {
+            qDebug() << "inserting" << picture.path << "failed:"
+                     << query.lastError().text();
+        }
+        success_ &= success;
     }
-    else if (done_) {
-        done(success_);
+    if (!db.commit()) {
+        qDebug() << "inserting in" << library_ << "failed:"
+                 << db.lastError().text();
+        db.rollback();
+        success_ = false;
+        return Step::kContinue;
     }
+
+    addToCounter(Counter::kInsertedRows, pictures.size());
+    nr_files_ += pictures.size();
+    progress(nr_files_, -1);
+    return Step::kContinue;
 }
 
 } // picpic
@@ -1,29 +1,29 @@
 #pragma once
 
-#include <QObject>
+#include <QSqlDatabase>
+#include <QStringList>
 
-#include "file_scanner.hpp"
-#include "pic_model.hpp"
+#include "jobs.hpp"
 
 namespace picpic {
 
-class Inserter : public QObject {
+// Adds the pictures found under a directory to the library. The files are
+// listed by a FileScanner stage while the ones found are inserted, on the
+// database thread of the scheduler with its own connection. The ratings of
+// their XMP sidecars are given to the new pictures only, the ones already in
+// the library keep theirs until an XmpImporter reads the sidecars.
+class Inserter : public Job {
     Q_OBJECT
 public:
-    Inserter(PicModel* model, const QString& path, QObject* parent = nullptr);
-    void onNext();
+    Inserter(QSqlDatabase db, const QString& path);
 
-signals:
-    void done(bool success);
-
-    // private signal
-    void next();
+protected:
+    Step step() override;
 
 private:
-    PicModel* model_;
-    FileScanner file_scanner_;
-    QStringList pending_files_;
-    bool done_{false};
+    const QString library_;
+    RatedPathQueue scanned_{this};
+    int nr_files_{0};
     bool success_{true};
 };
 
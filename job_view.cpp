@@ -0,0 +1,53 @@
+#include "job_view.hpp"
+
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QProgressBar>
+#include <QToolButton>
+
+namespace picpic {
+
+JobView::JobView(JobScheduler* scheduler, QWidget* parent)
+    : QWidget(parent), layout_{new QVBoxLayout(this)}
+{
+    layout_->setContentsMargins(0, 0, 0, 0);
+    connect(scheduler, &JobScheduler::jobAdded, this, &JobView::addJob);
+}
+
+void JobView::addJob(Job* job)
+{
+    auto row = new QWidget(this);
+    auto layout = new QHBoxLayout(row);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    auto label = new QLabel(job->name(), row);
+    // busy until the total is known
+    auto bar = new QProgressBar(row);
+    bar->setRange(0, 0);
+    auto pause = new QToolButton(row);
+    pause->setText("Pause");
+    pause->setCheckable(true);
+    auto cancel = new QToolButton(row);
+    cancel->setText("Cancel");
+
+    layout->addWidget(label);
+    layout->addWidget(bar);
+    layout->addWidget(pause);
+    layout->addWidget(cancel);
+    layout_->addWidget(row);
+
+    // the job is the context: nothing is called once it is deleted
+    connect(job, &Job::progress, row, [job, label, bar](int done, int total) {
+        if (total < 0) {
+            label->setText(QString("%1: %2").arg(job->name()).arg(done));
+            return;
+        }
+        bar->setRange(0, total);
+        bar->setValue(done);
+    });
+    connect(job, &Job::finished, row, &QObject::deleteLater);
+    connect(pause, &QToolButton::toggled, job, &Job::setPaused);
+    connect(cancel, &QToolButton::clicked, job, &Job::cancel);
+}
+
+} // picpic
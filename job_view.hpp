@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include "jobs.hpp"
+
+namespace picpic {
+
+// Progress of the jobs of a scheduler, each with buttons to pause and
+// cancel it. Rows are removed as jobs finish.
+class JobView : public QWidget {
+    Q_OBJECT
+public:
+    JobView(JobScheduler* scheduler, QWidget* parent = nullptr);
+
+private:
+    void addJob(Job* job);
+
+    QVBoxLayout* layout_;
+};
+
+} // picpic
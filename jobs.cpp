@@ -0,0 +1,245 @@
+#include "jobs.hpp"
+
+#include <functional>
+
+#include <QRunnable>
+#include <QThread>
+
+#include "database.hpp"
+#include "logging.hpp"
+
+namespace picpic {
+
+namespace {
+
+// more than a couple of readers make disks seek back and forth
+constexpr int kDiskLimit = 2;
+// SQLite has a single writer per library anyway
+constexpr int kDatabaseLimit = 1;
+
+class StepRunnable : public QRunnable {
+public:
+    explicit StepRunnable(std::function<void()> function)
+        : function_{std::move(function)}
+    {
+    }
+
+    void run() override { function_(); }
+
+private:
+    std::function<void()> function_;
+};
+
+} // <anonymous>
+
+Job::Job(QString name, Resource resource)
+    : name_{std::move(name)}, resource_{resource}
+{
+}
+
+void Job::cancel()
+{
+    cancelled_ = true;
+    if (scheduler_) {
+        QMetaObject::invokeMethod(
+            scheduler_,
+            [scheduler = scheduler_] { scheduler->schedule(); },
+            Qt::QueuedConnection);
+    }
+}
+
+void Job::setPaused(bool paused)
+{
+    paused_ = paused;
+    for (Job* upstream : upstream_) {
+        upstream->setPaused(paused);
+    }
+    if (scheduler_ && !paused) {
+        scheduler_->schedule();
+    }
+}
+
+void Job::addUpstream(Job* upstream)
+{
+    // owned by this job until it is scheduled
+    upstream->setParent(this);
+    upstream->downstream_ = this;
+    upstream_.push_back(upstream);
+}
+
+void Job::wake()
+{
+    woken_ = true;
+    if (scheduler_) {
+        QMetaObject::invokeMethod(
+            scheduler_,
+            [scheduler = scheduler_] { scheduler->schedule(); },
+            Qt::QueuedConnection);
+    }
+}
+
+JobScheduler::JobScheduler(QObject* parent)
+    : QObject(parent), database_context_{new QObject}
+{
+    database_context_->moveToThread(&database_thread_);
+    database_thread_.start();
+
+    limits_[static_cast<int>(Resource::kDisk)] = kDiskLimit;
+    limits_[static_cast<int>(Resource::kCpu)] = QThread::idealThreadCount();
+    limits_[static_cast<int>(Resource::kDatabase)] = kDatabaseLimit;
+    pool_.setMaxThreadCount(
+        limits_[static_cast<int>(Resource::kDisk)]
+        + limits_[static_cast<int>(Resource::kCpu)]);
+}
+
+JobScheduler::~JobScheduler()
+{
+    // the steps running see it, no other is started
+    for (Job* job : jobs_) {
+        job->cancelled_ = true;
+    }
+    pool_.waitForDone();
+    QMetaObject::invokeMethod(
+        database_context_,
+        [] { closeWorkerDatabases(); },
+        Qt::BlockingQueuedConnection);
+    database_thread_.quit();
+    database_thread_.wait();
+    delete database_context_;
+}
+
+void JobScheduler::setLimit(Resource resource, int limit)
+{
+    limits_[static_cast<int>(resource)] = limit;
+    pool_.setMaxThreadCount(
+        limits_[static_cast<int>(Resource::kDisk)]
+        + limits_[static_cast<int>(Resource::kCpu)]);
+    schedule();
+}
+
+void JobScheduler::add(Job* job, bool shown)
+{
+    addStage(job);
+    if (shown) {
+        jobAdded(job);
+    }
+    schedule();
+}
+
+void JobScheduler::addStage(Job* job)
+{
+    for (Job* upstream : job->upstream_) {
+        addStage(upstream);
+    }
+    job->setParent(this);
+    job->scheduler_ = this;
+    jobs_.push_back(job);
+}
+
+void JobScheduler::schedule()
+{
+    if (scheduling_) {
+        rescheduling_ = true;
+        return;
+    }
+    scheduling_ = true;
+    do {
+        rescheduling_ = false;
+        scheduleOnce();
+    } while (rescheduling_);
+    scheduling_ = false;
+}
+
+void JobScheduler::scheduleOnce()
+{
+    const QList<Job*> jobs = jobs_;
+    for (Job* job : jobs) {
+        if (job->cancelled_ || job->finishing_) {
+            for (Job* upstream : job->upstream_) {
+                upstream->cancelled_ = true;
+            }
+            if (!job->running_ && job->upstream_.isEmpty()) {
+                finish(job, !job->cancelled_ && !job->failed_);
+            }
+        }
+    }
+
+    // started jobs go last, the others get the next free resources
+    for (Job* job : QList<Job*>(jobs_)) {
+        if (job->waiting_ && job->woken_) {
+            job->waiting_ = false;
+        }
+        if (job->running_ || job->waiting_ || job->paused_
+            || job->cancelled_ || job->finishing_
+            || running(job->resource_)
+                   >= limits_[static_cast<int>(job->resource_)]) {
+            continue;
+        }
+        start(job);
+    }
+}
+
+void JobScheduler::start(Job* job)
+{
+    job->running_ = true;
+    job->woken_ = false;
+    ++running(job->resource_);
+    jobs_.removeOne(job);
+    jobs_.push_back(job);
+
+    auto run_step = [this, job] {
+        Job::Step step = job->step();
+        QMetaObject::invokeMethod(
+            this,
+            [this, job, step] { onStepDone(job, step); },
+            Qt::QueuedConnection);
+    };
+    if (job->resource_ == Resource::kDatabase) {
+        QMetaObject::invokeMethod(
+            database_context_, run_step, Qt::QueuedConnection);
+    }
+    else {
+        pool_.start(new StepRunnable{run_step});
+    }
+}
+
+void JobScheduler::onStepDone(Job* job, Job::Step step)
+{
+    job->running_ = false;
+    --running(job->resource_);
+
+    switch (step) {
+    case Job::Step::kContinue:
+        break;
+    case Job::Step::kWait:
+        job->waiting_ = true;
+        break;
+    case Job::Step::kDone:
+    case Job::Step::kFailed:
+        job->finishing_ = true;
+        job->failed_ = step == Job::Step::kFailed;
+        break;
+    }
+    schedule();
+}
+
+void JobScheduler::finish(Job* job, bool success)
+{
+    qCDebug(lcLibrary) << job->name() << (success ? "done" : "stopped");
+    jobs_.removeOne(job);
+    if (Job* downstream = job->downstream_) {
+        // it may wait for this stage to finish
+        downstream->upstream_.removeOne(job);
+        downstream->woken_ = true;
+        rescheduling_ = true;
+    }
+    job->finished(success);
+    job->deleteLater();
+}
+
+int& JobScheduler::running(Resource resource)
+{
+    return running_[static_cast<int>(resource)];
+}
+
+} // picpic
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+namespace picpic {
+
+class JobScheduler;
+
+// What a job mostly waits for. The scheduler bounds the number of jobs
+// using each resource at once.
+enum class Resource {
+    kDisk,
+    kCpu,
+    // libraries, through the connections of the database thread
+    kDatabase,
+    kCount
+};
+
+// A long running operation done in small steps, so that it can be
+// cancelled or paused between two of them. Jobs are run by a JobScheduler,
+// which owns them and deletes them once finished.
+class Job : public QObject {
+    Q_OBJECT
+signals:
+    // total is -1 while it is unknown
+    void progress(int done, int total);
+    // emitted on the thread of the scheduler, the job is deleted after
+    void finished(bool success);
+
+public:
+    enum class Step {
+        kContinue,
+        // nothing to do until wake() is called
+        kWait,
+        kDone,
+        kFailed,
+    };
+
+    Job(QString name, Resource resource);
+
+    const QString& name() const { return name_; }
+    Resource resource() const { return resource_; }
+
+    // Thread safe. The step running goes on, no other is started.
+    void cancel();
+    bool isCancelled() const { return cancelled_; }
+    void setPaused(bool paused);
+    bool isPaused() const { return paused_; }
+
+    // Make upstream a stage of the pipeline ending with this job: it is
+    // scheduled with it, cancelled or paused with it, and this job only
+    // finishes once upstream did.
+    void addUpstream(Job* upstream);
+
+protected:
+    // Do the next part of the work, it is called repeatedly until it
+    // returns kDone or kFailed. Steps of a job never run concurrently, they
+    // run on the pool of the scheduler, or on its database thread when the
+    // resource is kDatabase: see openWorkerDatabase.
+    virtual Step step() = 0;
+    // Thread safe, for upstream stages handing work to this one
+    void wake();
+
+private:
+    friend class JobScheduler;
+    template <typename T>
+    friend class StageQueue;
+
+    const QString name_;
+    const Resource resource_;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> paused_{false};
+    std::atomic<bool> woken_{false};
+    // only used by the scheduler, on its thread
+    JobScheduler* scheduler_{nullptr};
+    Job* downstream_{nullptr};
+    QList<Job*> upstream_;
+    bool running_{false};
+    bool waiting_{false};
+    // done or failed, once the upstream stages are finished too
+    bool finishing_{false};
+    bool failed_{false};
+};
+
+// Hands the items produced by a stage of a pipeline over to the next one
+template <typename T>
+class StageQueue {
+public:
+    // consumer is woken up whenever items are pushed or the queue closed
+    explicit StageQueue(Job* consumer) : consumer_{consumer} {}
+
+    void push(const QList<T>& items)
+    {
+        {
+            std::lock_guard lock{mutex_};
+            items_ += items;
+        }
+        if (consumer_) {
+            consumer_->wake();
+        }
+    }
+    // no more items will be pushed
+    void close()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            closed_ = true;
+        }
+        if (consumer_) {
+            consumer_->wake();
+        }
+    }
+    QList<T> take(int max)
+    {
+        std::lock_guard lock{mutex_};
+        QList<T> items = items_.mid(0, max);
+        items_.erase(items_.begin(), items_.begin() + items.size());
+        return items;
+    }
+    // closed and empty
+    bool isDone() const
+    {
+        std::lock_guard lock{mutex_};
+        return closed_ && items_.isEmpty();
+    }
+
+private:
+    Job* consumer_;
+    mutable std::mutex mutex_;
+    QList<T> items_;
+    bool closed_{false};
+};
+
+using PathQueue = StageQueue<QString>;
+
+struct RatedPath {
+    QString path;
+    // -1 when it is not known
+    int rating{-1};
+};
+
+using RatedPathQueue = StageQueue<RatedPath>;
+
+class JobScheduler : public QObject {
+    Q_OBJECT
+signals:
+    // emitted for the jobs given to add() as shown, not their upstream
+    // stages
+    void jobAdded(Job* job);
+
+public:
+    explicit JobScheduler(QObject* parent = nullptr);
+    // cancels the jobs and waits for the steps running
+    ~JobScheduler() override;
+
+    // Maximum number of steps using the resource at once
+    void setLimit(Resource resource, int limit);
+    // Start job and its upstream stages, the scheduler takes ownership. The
+    // short writes of the models are not shown.
+    void add(Job* job, bool shown = true);
+
+private:
+    void addStage(Job* job);
+    void schedule();
+    void scheduleOnce();
+    void start(Job* job);
+    void onStepDone(Job* job, Job::Step step);
+    void finish(Job* job, bool success);
+    int& running(Resource resource);
+
+    friend class Job;
+
+    QList<Job*> jobs_;
+    int limits_[static_cast<int>(Resource::kCount)];
+    int running_[static_cast<int>(Resource::kCount)]{};
+    QThreadPool pool_;
+    // the connections of a thread cannot be used by another one
+    QThread database_thread_;
+    QObject* database_context_;
+    // finished() handlers may add jobs while jobs are scheduled
+    bool scheduling_{false};
+    bool rescheduling_{false};
+};
+
+} // picpic
@@ -0,0 +1,8 @@
+#include "logging.hpp"
+
+namespace picpic {
+
+Q_LOGGING_CATEGORY(lcLoader, "picpic.loader", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcLibrary, "picpic.library", QtInfoMsg)
+
+} // picpic
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QLoggingCategory>
+
+namespace picpic {
+
+// Messages logged per picture or per file. Their debug level is disabled by
+// default so that they cost a flag check, enable it with
+// QT_LOGGING_RULES="picpic.*.debug=true".
+Q_DECLARE_LOGGING_CATEGORY(lcLoader)
+Q_DECLARE_LOGGING_CATEGORY(lcLibrary)
+
+} // picpic
@@ -1,17 +1,103 @@
+#include <algorithm>
+
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QStyleFactory>
 
 #include "main_window.hpp"
+#include "trace.hpp"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Time spent by the process before main(), loading the libraries, with
+// the resolution of the kernel clock ticks. 0 where it is not known.
+qint64 msBeforeMain()
+{
+#ifdef __linux__
+    QFile uptime_file{"/proc/uptime"};
+    QFile stat_file{"/proc/self/stat"};
+    if (!uptime_file.open(QIODevice::ReadOnly)
+        || !stat_file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    double uptime_s = uptime_file.readAll().split(' ').value(0).toDouble();
+    // the command may contain spaces, fields are counted after it
+    QByteArray stat = stat_file.readAll();
+    QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+    // starttime is the 22nd field, the 20th after the command
+    qint64 start_ticks = fields.value(19).toLongLong();
+    double start_s = double(start_ticks) / sysconf(_SC_CLK_TCK);
+    return std::max<qint64>(0, qint64((uptime_s - start_s) * 1000));
+#else
+    return 0;
+#endif
+}
+
+} // <anonymous>
 
 int main(int argc, char* argv[])
 {
+    QElapsedTimer startup_timer;
+    startup_timer.start();
+    qint64 before_main_ms = msBeforeMain();
+
     QApplication app(argc, argv);
 #ifdef _WIN32
     app.setStyle(QStyleFactory::create("fusion"));
 #endif
 
+    // PICPIC_TRACE=<file> records a Chrome trace written at exit
+    const QString trace_path = qEnvironmentVariable("PICPIC_TRACE");
+    picpic::setTracingEnabled(!trace_path.isEmpty());
+
     picpic::MainWindow main_window;
+
+    // PICPIC_STARTUP_BENCH=<file> writes the time from the start of the
+    // process to the first picture painted, with the session of the last
+    // run, then quits
+    const QString startup_bench_path =
+        qEnvironmentVariable("PICPIC_STARTUP_BENCH");
+    qint64 first_paint_ms = -1;
+    if (!startup_bench_path.isEmpty()) {
+        QObject::connect(
+            &main_window,
+            &picpic::MainWindow::picturePainted,
+            &app,
+            [&](bool decoded) {
+                qint64 elapsed_ms = before_main_ms + startup_timer.elapsed();
+                if (first_paint_ms < 0) {
+                    first_paint_ms = elapsed_ms;
+                }
+                if (!decoded) {
+                    return;
+                }
+                QFile file{startup_bench_path};
+                if (file.open(QIODevice::WriteOnly)) {
+                    QJsonObject result{
+                        {"name", "startup"},
+                        {"before_main_ms", before_main_ms},
+                        {"first_paint_ms", first_paint_ms},
+                        {"first_decoded_paint_ms", elapsed_ms},
+                    };
+                    file.write(QJsonDocument(result).toJson());
+                }
+                QObject::disconnect(&main_window, nullptr, &app, nullptr);
+                app.quit();
+            });
+    }
+
     main_window.showMaximized();
 
-    return app.exec();
+    int result = app.exec();
+    if (!trace_path.isEmpty()) {
+        picpic::writeChromeTrace(trace_path);
+    }
+    return result;
 }
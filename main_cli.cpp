@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "analyzer.hpp"
+#include "database.hpp"
+#include "exporter.hpp"
+#include "inserter.hpp"
+#include "jobs.hpp"
+#include "trace.hpp"
+#include "xmp_exporter.hpp"
+#include "xmp_importer.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kDefaultJobs = 4;
+
+bool openLibrary(const QString& library, QSqlDatabase& db)
+{
+    db = openPicDatabase(library);
+    if (!db.isOpen()) {
+        std::fprintf(
+            stderr,
+            "cannot open %s: %s\n",
+            qPrintable(library),
+            qPrintable(db.lastError().text()));
+        return false;
+    }
+    // nothing is browsed meanwhile, the indexes are built at once
+    return migratePicDatabase(db, "main", true);
+}
+
+// Open library with the attached ones, table is where their pictures are
+bool openLibraries(
+    const QString& library,
+    const QStringList& attached,
+    QSqlDatabase& db,
+    QString& table)
+{
+    if (!openLibrary(library, db)) {
+        return false;
+    }
+    for (const auto& path : attached) {
+        // the attached libraries are only read, they are upgraded by the
+        // upgrade command
+        if (libraryNeedsUpgrade(path)) {
+            std::fprintf(
+                stderr,
+                "%s must be upgraded first: picpic-cli upgrade %s\n",
+                qPrintable(path),
+                qPrintable(path));
+            return false;
+        }
+        if (!attachLibrary(db, path, false)) {
+            std::fprintf(stderr, "cannot attach %s\n", qPrintable(path));
+            return false;
+        }
+    }
+    table = attached.isEmpty() ? kPicturesTable : kAllPicturesView;
+    return true;
+}
+
+int scan(QCoreApplication& app, const QString& library, const QString& dir)
+{
+    QSqlDatabase db;
+    if (!openLibrary(library, db)) {
+        return 1;
+    }
+
+    bool result = false;
+    JobScheduler scheduler;
+    auto inserter = new Inserter(db, dir);
+    QObject::connect(inserter, &Job::progress, [](int nr_files) {
+        std::printf("\r%d files", nr_files);
+        std::fflush(stdout);
+    });
+    QObject::connect(inserter, &Job::finished, [&](bool success) {
+        result = success;
+        app.quit();
+    });
+    scheduler.add(inserter);
+    app.exec();
+
+    std::printf("\n");
+    if (!result) {
+        std::fprintf(stderr, "some files could not be added\n");
+    }
+    return result ? 0 : 1;
+}
+
+int exportPictures(
+    QCoreApplication& app,
+    const QString& library,
+    const QStringList& attached,
+    const QString& dst_dir,
+    int min_rating,
+    double min_sharpness,
+    int jobs)
+{
+    QSqlDatabase db;
+    QString table;
+    if (!openLibraries(library, attached, db, table)) {
+        return 1;
+    }
+
+    // pictures not analyzed yet are exported
+    const QString condition =
+        QString("rating >= %1 AND (sharpness IS NULL OR sharpness >= %2)")
+            .arg(min_rating)
+            .arg(min_sharpness);
+
+    // the selection is split by id over the exporters, they copy in
+    // parallel
+    JobScheduler scheduler;
+    scheduler.setLimit(Resource::kDisk, jobs);
+    int total = 0;
+    int copied = 0;
+    int running = jobs;
+    for (int i = 0; i < jobs; ++i) {
+        auto exporter = new Exporter(
+            dst_dir,
+            db,
+            Selection::matching(
+                table,
+                QString("(%1) AND id % %2 = %3")
+                    .arg(condition)
+                    .arg(jobs)
+                    .arg(i)));
+        QObject::connect(exporter, &Job::finished, &app, [&, exporter] {
+            total += exporter->nrFiles();
+            copied += exporter->nrCopied();
+            if (--running == 0) {
+                app.quit();
+            }
+        });
+        scheduler.add(exporter);
+    }
+    app.exec();
+
+    std::printf("copied %d/%d files to %s\n", copied, total, qPrintable(dst_dir));
+    return copied == total ? 0 : 1;
+}
+
+int analyze(
+    QCoreApplication& app,
+    const QString& library,
+    const QStringList& attached)
+{
+    QSqlDatabase db;
+    QString table;
+    if (!openLibraries(library, attached, db, table)) {
+        return 1;
+    }
+
+    bool result = false;
+    JobScheduler scheduler;
+    auto analyzer = new Analyzer(
+        db, Selection::matching(table, "sharpness IS NULL"));
+    int nr_analyzed = 0;
+    QObject::connect(analyzer, &Job::progress, [](int done) {
+        std::printf("\r%d pictures", done);
+        std::fflush(stdout);
+    });
+    QObject::connect(analyzer, &Job::finished, [&](bool success) {
+        nr_analyzed = analyzer->nrAnalyzed();
+        result = success;
+        app.quit();
+    });
+    scheduler.add(analyzer);
+    app.exec();
+
+    std::printf("\ranalyzed %d pictures\n", nr_analyzed);
+    if (!result) {
+        std::fprintf(stderr, "some metrics could not be stored\n");
+    }
+    return result ? 0 : 1;
+}
+
+int writeXmp(
+    QCoreApplication& app,
+    const QString& library,
+    const QStringList& attached)
+{
+    QSqlDatabase db;
+    QString table;
+    if (!openLibraries(library, attached, db, table)) {
+        return 1;
+    }
+
+    bool result = false;
+    JobScheduler scheduler;
+    auto exporter = new XmpExporter(db, Selection::matching(table, {}));
+    int nr_written = 0;
+    int nr_failed = 0;
+    QObject::connect(exporter, &Job::progress, [](int done) {
+        std::printf("\r%d pictures", done);
+        std::fflush(stdout);
+    });
+    QObject::connect(exporter, &Job::finished, [&](bool success) {
+        nr_written = exporter->nrWritten();
+        nr_failed = exporter->nrFailed();
+        result = success;
+        app.quit();
+    });
+    scheduler.add(exporter);
+    app.exec();
+
+    std::printf("\rwrote %d sidecars\n", nr_written);
+    if (!result) {
+        std::fprintf(stderr, "%d sidecars could not be written\n", nr_failed);
+    }
+    return result ? 0 : 1;
+}
+
+int readXmp(
+    QCoreApplication& app,
+    const QString& library,
+    const QStringList& attached)
+{
+    QSqlDatabase db;
+    QString table;
+    if (!openLibraries(library, attached, db, table)) {
+        return 1;
+    }
+
+    bool result = false;
+    JobScheduler scheduler;
+    auto importer = new XmpImporter(db, Selection::matching(table, {}));
+    int nr_imported = 0;
+    QObject::connect(importer, &Job::finished, [&](bool success) {
+        nr_imported = importer->nrImported();
+        result = success;
+        app.quit();
+    });
+    scheduler.add(importer);
+    app.exec();
+
+    std::printf("imported %d ratings\n", nr_imported);
+    if (!result) {
+        std::fprintf(stderr, "some ratings could not be imported\n");
+    }
+    return result ? 0 : 1;
+}
+
+int upgrade(const QString& library)
+{
+    QSqlDatabase db;
+    if (!openLibrary(library, db)) {
+        std::fprintf(stderr, "cannot upgrade %s\n", qPrintable(library));
+        return 1;
+    }
+    std::printf("%s is up to date\n", qPrintable(library));
+    return 0;
+}
+
+int stats(const QString& library, const QStringList& attached)
+{
+    QSqlDatabase db;
+    QString table;
+    if (!openLibraries(library, attached, db, table)) {
+        return 1;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec(QString("SELECT COALESCE(rating, 0) AS r, COUNT(*) "
+                            "FROM %1 GROUP BY r ORDER BY r")
+                        .arg(table))) {
+        std::fprintf(stderr, "%s\n", qPrintable(query.lastError().text()));
+        return 1;
+    }
+
+    int total = 0;
+    while (query.next()) {
+        int count = query.value(1).toInt();
+        std::printf("rating %d: %d\n", query.value(0).toInt(), count);
+        total += count;
+    }
+    std::printf("total: %d\n", total);
+    return 0;
+}
+
+} // <anonymous>
+
+} // picpic
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    // the thumbnails are cached with the ones of the GUI
+    app.setApplicationName("picpic");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Manage picpic libraries without a display.\n"
+        "\n"
+        "Commands:\n"
+        "  scan <library> <directory>     add the pictures of a directory\n"
+        "  export <library> <destination> copy the pictures of a library\n"
+        "  analyze <library>              measure the sharpness and exposure\n"
+        "                                 of the pictures not measured yet\n"
+        "  write-xmp <library>            write the ratings to XMP sidecars\n"
+        "  read-xmp <library>             read the ratings of XMP sidecars\n"
+        "  upgrade <library>              upgrade a library created by an\n"
+        "                                 older version to attach it\n"
+        "  stats <library>                count the pictures per rating");
+    parser.addHelpOption();
+    parser.addPositionalArgument(
+        "command",
+        "scan, export, analyze, write-xmp, read-xmp, upgrade or stats");
+    QCommandLineOption min_rating_option(
+        "min-rating", "Export pictures rated at least <rating>.", "rating", "0");
+    QCommandLineOption min_sharpness_option(
+        "min-sharpness",
+        "Export pictures at least this sharp, or not analyzed yet.",
+        "sharpness",
+        "0");
+    QCommandLineOption jobs_option(
+        QStringList{"j", "jobs"},
+        "Number of files exported in parallel.",
+        "jobs",
+        QString::number(picpic::kDefaultJobs));
+    QCommandLineOption attach_option(
+        "attach",
+        "Export, analyze, sync or count the pictures of <library> too, may "
+        "be repeated.",
+        "library");
+    QCommandLineOption trace_option(
+        "trace", "Write a Chrome trace of the command to <file>.", "file");
+    parser.addOption(min_rating_option);
+    parser.addOption(min_sharpness_option);
+    parser.addOption(jobs_option);
+    parser.addOption(attach_option);
+    parser.addOption(trace_option);
+    parser.process(app);
+
+    const QString trace_path = parser.value(trace_option);
+    picpic::setTracingEnabled(!trace_path.isEmpty());
+    auto run = [&]() -> int {
+        const QStringList args = parser.positionalArguments();
+        const QString command = args.value(0);
+        if (command == "scan" && args.size() == 3) {
+            return picpic::scan(app, args[1], args[2]);
+        }
+        else if (command == "export" && args.size() == 3) {
+            return picpic::exportPictures(
+                app,
+                args[1],
+                parser.values(attach_option),
+                args[2],
+                parser.value(min_rating_option).toInt(),
+                parser.value(min_sharpness_option).toDouble(),
+                std::max(1, parser.value(jobs_option).toInt()));
+        }
+        else if (command == "analyze" && args.size() == 2) {
+            return picpic::analyze(app, args[1], parser.values(attach_option));
+        }
+        else if (command == "write-xmp" && args.size() == 2) {
+            return picpic::writeXmp(app, args[1], parser.values(attach_option));
+        }
+        else if (command == "read-xmp" && args.size() == 2) {
+            return picpic::readXmp(app, args[1], parser.values(attach_option));
+        }
+        else if (command == "upgrade" && args.size() == 2) {
+            return picpic::upgrade(args[1]);
+        }
+        else if (command == "stats" && args.size() == 2) {
+            return picpic::stats(args[1], parser.values(attach_option));
+        }
+        parser.showHelp(1);
+    };
+
+    int result = run();
+    if (!trace_path.isEmpty()) {
+        picpic::writeChromeTrace(trace_path);
+    }
+    return result;
+}
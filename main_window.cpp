@@ -1,8 +1,10 @@
 #include "main_window.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 #include <QApplication>
+#include <QCloseEvent>
 #include <QDebug>
 #include <QDesktopServices>
 #include <QFileDialog>
@@ -10,23 +12,51 @@
 #include <QLabel>
 #include <QMessageBox>
 #include <QPixmap>
+#include <QSet>
+#include <QSettings>
 #include <QShortcut>
 #include <QSplitter>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QStatusBar>
 #include <QStyle>
 #include <QTableView>
+#include <QTimer>
 #include <QToolBar>
 #include <QVBoxLayout>
 
+#include "analyzer.hpp"
 #include "file_scanner.hpp"
 #include "pic_model.hpp"
+#include "thumbnail_cache.hpp"
+#include "trace.hpp"
+#include "xmp_exporter.hpp"
 
 namespace picpic {
 
 namespace {
 
 constexpr int kMaxRating = 5;
+constexpr int kCachedPictures = 12;
+constexpr int kListThumbnailSize = 32;
+constexpr int kGridThumbnailSize = kThumbnailCacheSize;
+
+// not set as the organization of the application, it would move the
+// thumbnail cache of QStandardPaths
+constexpr const char* kSettingsOrganization = "picpic";
+constexpr const char* kSettingsApplication = "picpic";
+constexpr const char* kSessionLibrary = "session/library";
+constexpr const char* kSessionAttached = "session/attached";
+constexpr const char* kSessionMinRating = "session/min_rating";
+constexpr const char* kSessionGrid = "session/grid";
+constexpr const char* kSessionAllSelected = "session/all_selected";
+constexpr const char* kSessionSelectedIds = "session/selected_ids";
+constexpr const char* kSessionTopId = "session/top_id";
+// the picture shown first, then its neighbours
+constexpr const char* kSessionPictures = "session/pictures";
+constexpr const char* kSessionRotations = "session/rotations";
+// larger selections are not restored, but a selection of all the pictures
+constexpr int kMaxSessionSelection = 1000;
 
 class KeyListener : public QObject {
 public:
@@ -48,7 +78,7 @@ private:
 
 } // <anonymous>
 
-MainWindow::MainWindow()
+MainWindow::MainWindow() : pixmap_cache_{kCachedPictures}
 {
     // Listen keyboard events
     qApp->installEventFilter(new KeyListener(this));
@@ -56,6 +86,15 @@ MainWindow::MainWindow()
     createActions();
     createShortcuts();
     createMainWidget();
+
+    // once the window is shown, its first paint is not delayed
+    QTimer::singleShot(0, this, &MainWindow::restoreSession);
+}
+
+void MainWindow::closeEvent(QCloseEvent* event)
+{
+    saveSession();
+    QMainWindow::closeEvent(event);
 }
 
 bool MainWindow::keyEvent(QKeyEvent* event)
@@ -94,6 +133,58 @@ void MainWindow::onOpenAction()
     createNewModel(path);
 }
 
+void MainWindow::onAttachAction()
+{
+    QString path = QFileDialog::getOpenFileName(
+        this, "Attach library", QString(), "SQLite (*.sqlite);;Any (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    QSqlDatabase db = model_->database();
+    if (isLibraryFile(db, path)) {
+        QMessageBox::warning(
+            this,
+            "Attach error",
+            QString("%1 is open already").arg(path));
+        return;
+    }
+    // it is only changed once the user agreed
+    bool upgrade = libraryNeedsUpgrade(path);
+    if (upgrade
+        && QMessageBox::question(
+               this,
+               "Upgrade library",
+               QString("%1 was created by an older version of picpic, it "
+                       "must be upgraded to be browsed. The older versions "
+                       "may not open it anymore.\n"
+                       "\n"
+                       "Upgrade it?")
+                   .arg(path))
+               != QMessageBox::Yes) {
+        return;
+    }
+    qDebug() << "attaching" << path;
+
+    // the view is rebuilt, nothing may read it meanwhile
+    QString table = model_->tableName();
+    delete model_;
+    model_ = nullptr;
+
+    if (!attachLibrary(db, path, upgrade)) {
+        QMessageBox::warning(
+            this,
+            "Attach error",
+            QString("%1 could not be attached").arg(path));
+        createModel(db, table);
+        return;
+    }
+    attached_.push_back(path);
+    createModel(db, kAllPicturesView);
+    if (upgrade) {
+        startMigration(path);
+    }
+}
+
 void MainWindow::onScanAction()
 {
     if (!model_) {
@@ -108,33 +199,28 @@ void MainWindow::onScanAction()
     }
 
     qDebug() << "scanning" << path;
-    scan_modal_ =
-        new QProgressDialog("Scanning files, please wait ...", "", 0, 0, this);
-    scan_modal_->setCancelButton(nullptr);
-    scan_modal_->open();
-    inserter_ = new Inserter(model_, path, this);
-    connect(inserter_, &Inserter::done, this, [this](bool success) {
-        model_->select();
-
-        delete scan_modal_;
-        scan_modal_ = nullptr;
-
-        if (!success) {
+    // the library can be browsed and culled meanwhile, it is selected again
+    // at the end only: a selection resets the views
+    auto inserter = new Inserter(model_->database(), path);
+    connect(inserter, &Job::finished, this, [this, inserter](bool success) {
+        if (model_) {
+            model_->select();
+        }
+        if (!success && !inserter->isCancelled()) {
             QMessageBox::warning(
                 this,
                 "Scan error",
                 "Some files have been detected but could not be added");
         }
-
-        inserter_->deleteLater();
-        inserter_ = nullptr;
     });
+    scheduler_->add(inserter);
 }
 
 void MainWindow::onExportAction()
 {
-    const auto selected_rows = file_view_->selectedRows();
-    if (selected_rows.isEmpty()) {
+    // the paths are read from the libraries by the exporter
+    Selection selection = model_->selection(file_view_->selectedRanges());
+    if (selection.isEmpty()) {
         QMessageBox::warning(
             this, "No selection", "Please select pictures first");
         return;
@@ -145,43 +231,64 @@ void MainWindow::onExportAction()
         return;
     }
 
-    auto srcs = [&]() {
-        QVector<QString> srcs;
-        srcs.reserve(selected_rows.size());
-        for (int row : selected_rows) {
-            srcs.push_back(
-                model_->index(row, PicModel::kColPath).data().toString());
-        };
-        return srcs;
-    }();
-    qDebug() << "exporting" << srcs.size() << "files to" << dst_dir;
-
-    export_modal_ = new QProgressDialog(
-        "Exporting files, please wait ...", "", 0, srcs.size(), this);
-    export_modal_->setCancelButton(nullptr);
-    export_modal_->open();
-    exporter_ = new Exporter(std::move(dst_dir), std::move(srcs), this);
-    connect(exporter_, &Exporter::progress, this, [this](int nr_files) {
-        export_modal_->setValue(nr_files);
-    });
-    connect(exporter_, &Exporter::done, this, [this](int copied) {
-        delete export_modal_;
-        export_modal_ = nullptr;
+    qDebug() << "exporting" << selection.size() << "files to" << dst_dir;
 
-        if (copied != exporter_->nrFiles()) {
+    auto exporter =
+        new Exporter(std::move(dst_dir), model_->database(), selection);
+    connect(exporter, &Job::finished, this, [this, exporter](bool success) {
+        if (!success && !exporter->isCancelled()) {
             QMessageBox::warning(
                 this,
                 "Export error",
                 QString("%1/%2 have been copied to %3")
-                    .arg(copied)
-                    .arg(exporter_->nrFiles())
-                    .arg(exporter_->dst()));
+                    .arg(exporter->nrCopied())
+                    .arg(exporter->nrFiles())
+                    .arg(exporter->dst()));
         }
+    });
+    scheduler_->add(exporter);
+}
+
+void MainWindow::onAnalyzeAction()
+{
+    // the thumbnails loaded meanwhile are analyzed by the model
+    auto analyzer = new Analyzer(
+        model_->database(),
+        Selection::matching(model_->tableName(), "sharpness IS NULL"));
+    connect(analyzer, &Job::finished, this, [this, analyzer](bool success) {
+        if (model_) {
+            model_->select();
+        }
+        if (!success && !analyzer->isCancelled()) {
+            QMessageBox::warning(
+                this,
+                "Analysis error",
+                "The metrics of some pictures could not be stored");
+        }
+    });
+    scheduler_->add(analyzer);
+}
+
+void MainWindow::onWriteXmpAction()
+{
+    Selection selection = model_->selection(file_view_->selectedRanges());
+    if (selection.isEmpty()) {
+        QMessageBox::warning(
+            this, "No selection", "Please select pictures first");
+        return;
+    }
 
-        exporter_->deleteLater();
-        exporter_ = nullptr;
+    auto exporter = new XmpExporter(model_->database(), selection);
+    connect(exporter, &Job::finished, this, [this, exporter](bool success) {
+        if (!success && !exporter->isCancelled()) {
+            QMessageBox::warning(
+                this,
+                "XMP error",
+                QString("%1 sidecars could not be written")
+                    .arg(exporter->nrFailed()));
+        }
     });
-    exporter_->start();
+    scheduler_->add(exporter);
 }
 
 void MainWindow::onHelpAction()
@@ -193,52 +300,77 @@ void MainWindow::onHelpAction()
         "and rating and they are stored on your file system.\n"
         "\n"
         "1. Create or open a library.\n"
-        "2. Add pictures to your library with the \"Scan directory\" button.\n"
+        "2. Add pictures to your library with the \"Scan directory\" button. "
+        "Other libraries can be attached to browse them all together.\n"
         "3. Give a rating to your pictures with the '0' to '5' buttons of your "
         "keyboard.\n"
         "4. Select and export the pictures you want to keep with the \"Export "
         "selection\" button.\n"
         "\n"
+        "The sharpness and the clipped highlights and shadows of the pictures "
+        "are measured when their thumbnail is shown, or by the \"Analyze\" "
+        "button for the whole library. Sort the library by these columns to "
+        "find the blurry or badly exposed pictures.\n"
+        "\n"
+        "Video clips (MOV, MP4) are added along with the pictures when the "
+        "ffmpeg tool is installed, and shown through their first keyframe.\n"
+        "\n"
+        "The ratings found in XMP sidecars, such as IMG_1.xmp or "
+        "IMG_1.jpg.xmp, are given to the pictures added by a scan, and "
+        "replace the ones of the library with picpic-cli read-xmp. The "
+        "\"Write XMP\" button writes the ratings of the selection to them "
+        "for other tools.\n"
+        "\n"
         "Shortcuts:\n"
         "'0' to '5': rate a picture\n"
         "'R': rotate\n"
+        "'Ctrl+A': select all the pictures shown, the filter is used to "
+        "rate, export or remove them\n"
+        "'C': compare the selected pictures side by side\n"
+        "'F12': show performance statistics\n"
         "'Del': remove a picture from the library\n"
         "'Up' and 'Down': navigate the library\n");
 }
 
-void MainWindow::onDeleteSelection()
+void MainWindow::onGridAction(bool enabled)
 {
-    auto rows = file_view_->selectedRows();
-    if (rows.empty()) {
-        return;
+    if (enabled) {
+        file_stack_->setCurrentWidget(thumbnail_view_);
+    }
+    else {
+        file_stack_->setCurrentWidget(file_view_);
     }
 
-    delete_modal_ = new QProgressDialog(
-        "Deleting entries, please wait ...", "", 0, rows.size(), this);
-    delete_modal_->setCancelButton(nullptr);
-    delete_modal_->open();
-
-    deleter_ = new Deleter(model_, rows, this);
-    connect(deleter_, &Deleter::progress, this, [this](int row) {
-        delete_modal_->setValue(row);
-    });
-    connect(deleter_, &Deleter::done, this, [this](bool success) {
-        model_->select();
+    if (model_) {
+        model_->setThumbnailSize(
+            enabled ? kGridThumbnailSize : kListThumbnailSize);
+    }
+}
 
-        delete delete_modal_;
-        delete_modal_ = nullptr;
+void MainWindow::onDeleteSelection()
+{
+    if (!model_) {
+        return;
+    }
+    Selection selection = model_->selection(file_view_->selectedRanges());
+    if (selection.isEmpty()) {
+        return;
+    }
 
-        if (!success) {
+    auto deleter = new Deleter(model_->database(), selection);
+    connect(deleter, &Job::finished, this, [this, deleter](bool success) {
+        if (model_) {
+            model_->select();
+        }
+        if (!success && !deleter->isCancelled()) {
             QMessageBox::warning(
                 this,
                 "Delete error",
                 QString("Error while deleting entries: %1")
-                    .arg(model_->lastError().text()));
+                    .arg(deleter->errorString()));
         }
-
-        deleter_->deleteLater();
-        deleter_ = nullptr;
     });
+    scheduler_->add(deleter);
 }
 
 void MainWindow::createActions()
@@ -262,6 +394,16 @@ void MainWindow::createActions()
     open_act->setStatusTip("Open a library");
     connect(open_act, &QAction::triggered, this, &MainWindow::onOpenAction);
 
+    QIcon attach_icon = style()->standardIcon(QStyle::SP_DirOpenIcon);
+    QAction* attach_act = new QAction(attach_icon, "&Attach", this);
+    attach_act->setShortcut(QKeySequence("Ctrl+Shift+O"));
+    attach_act->setStatusTip(
+        "Browse the pictures of another library with the open one");
+    connect(
+        attach_act, &QAction::triggered, this, &MainWindow::onAttachAction);
+    attach_act->setEnabled(false);
+    attach_action_ = attach_act;
+
     QIcon scan_icon = style()->standardIcon(QStyle::SP_DriveHDIcon);
     QAction* scan_act = new QAction(scan_icon, "S&can directory", this);
     scan_act->setShortcut(QKeySequence("Ctrl+K"));
@@ -279,6 +421,33 @@ void MainWindow::createActions()
     export_act->setEnabled(false);
     export_action_ = export_act;
 
+    QIcon analyze_icon =
+        style()->standardIcon(QStyle::SP_FileDialogDetailedView);
+    QAction* analyze_act = new QAction(analyze_icon, "Ana&lyze", this);
+    analyze_act->setShortcut(QKeySequence("Ctrl+L"));
+    analyze_act->setStatusTip(
+        "Measure the sharpness and exposure of the pictures not measured yet");
+    connect(
+        analyze_act, &QAction::triggered, this, &MainWindow::onAnalyzeAction);
+    analyze_act->setEnabled(false);
+    analyze_action_ = analyze_act;
+
+    QIcon xmp_icon = style()->standardIcon(QStyle::SP_DialogSaveButton);
+    QAction* xmp_act = new QAction(xmp_icon, "Write &XMP", this);
+    xmp_act->setShortcut(QKeySequence("Ctrl+Shift+X"));
+    xmp_act->setStatusTip("Write the ratings of the selection to XMP sidecars");
+    connect(xmp_act, &QAction::triggered, this, &MainWindow::onWriteXmpAction);
+    xmp_act->setEnabled(false);
+    xmp_action_ = xmp_act;
+
+    QIcon grid_icon = style()->standardIcon(QStyle::SP_FileDialogContentsView);
+    QAction* grid_act = new QAction(grid_icon, "&Thumbnails", this);
+    grid_act->setShortcut(QKeySequence("Ctrl+G"));
+    grid_act->setStatusTip("Show the library as a grid of thumbnails");
+    grid_act->setCheckable(true);
+    connect(grid_act, &QAction::toggled, this, &MainWindow::onGridAction);
+    grid_action_ = grid_act;
+
     QIcon help_icon = style()->standardIcon(QStyle::SP_DialogHelpButton);
     QAction* help_act = new QAction(help_icon, "&Help", this);
     export_act->setShortcut(QKeySequence("Ctrl+H"));
@@ -287,8 +456,12 @@ void MainWindow::createActions()
 
     toolbar->addAction(new_act);
     toolbar->addAction(open_act);
+    toolbar->addAction(attach_act);
     toolbar->addAction(scan_act);
     toolbar->addAction(export_act);
+    toolbar->addAction(analyze_act);
+    toolbar->addAction(xmp_act);
+    toolbar->addAction(grid_act);
     toolbar->addAction(help_act);
 }
 
@@ -297,14 +470,37 @@ void MainWindow::createShortcuts()
     for (int i = 0; i < kMaxRating + 1; ++i) {
         QShortcut* shortcut = new QShortcut(QKeySequence('0' + i), this);
         connect(shortcut, &QShortcut::activated, [this, i] {
-            for (int row : file_view_->selectedRows()) {
-                model_->setData(model_->index(row, PicModel::kColRating), i);
+            if (!model_) {
+                return;
             }
+            // shown at once, the libraries are written in the background
+            model_->rate(file_view_->selectedRanges(), i);
         });
     }
 
     QShortcut* rotate = new QShortcut(Qt::Key_R, this);
-    connect(rotate, &QShortcut::activated, [this] { image_viewer_->rotate(); });
+    connect(rotate, &QShortcut::activated, [this] {
+        if (!model_) {
+            return;
+        }
+        // the rotation is stored in the library and applied by the loaders,
+        // the selection is rotated at once by a single job
+        model_->rotate(file_view_->selectedRanges(), 1);
+        updateImage();
+    });
+
+    QShortcut* compare = new QShortcut(Qt::Key_C, this);
+    connect(compare, &QShortcut::activated, [this] {
+        compare_mode_ = !compare_mode_;
+        if (model_) {
+            updateImage();
+        }
+    });
+
+    QShortcut* overlay = new QShortcut(Qt::Key_F12, this);
+    connect(overlay, &QShortcut::activated, [this] {
+        perf_overlay_->setVisible(!perf_overlay_->isVisible());
+    });
 }
 
 void MainWindow::createMainWidget()
@@ -314,22 +510,49 @@ void MainWindow::createMainWidget()
     filter_spin_box_->setMinimum(0);
     filter_spin_box_->setMaximum(kMaxRating);
     file_view_ = new FileView(this);
+    thumbnail_view_ = new ThumbnailView(kGridThumbnailSize, this);
+
+    file_stack_ = new QStackedWidget(this);
+    file_stack_->addWidget(file_view_);
+    file_stack_->addWidget(thumbnail_view_);
 
-    image_viewer_ = new ImageViewer(this);
+    image_viewer_ = new ImageViewer(&pixmap_cache_, this);
+    connect(
+        image_viewer_,
+        &ImageViewer::painted,
+        this,
+        &MainWindow::picturePainted);
     image_viewer_->setMinimumSize(800, 600);
     image_viewer_->setAlignment(Qt::AlignCenter);
 
-    connect(file_view_, &FileView::activated, [](const QModelIndex& index) {
+    compare_view_ = new CompareView(&pixmap_cache_, this);
+
+    viewer_stack_ = new QStackedWidget(this);
+    viewer_stack_->addWidget(image_viewer_);
+    viewer_stack_->addWidget(compare_view_);
+
+    perf_overlay_ = new PerfOverlay(viewer_stack_);
+
+    scheduler_ = new JobScheduler(this);
+    statusBar()->addPermanentWidget(new JobView(scheduler_, this));
+
+    auto open_file = [](const QModelIndex& index) {
         QString path =
             index.sibling(index.row(), PicModel::kColPath).data().toString();
         qDebug() << "opening" << path;
         QDesktopServices::openUrl(QUrl("file:///" + path));
-    });
+    };
+    connect(file_view_, &FileView::activated, open_file);
+    connect(thumbnail_view_, &ThumbnailView::activated, open_file);
 
     connect(
         filter_spin_box_,
         static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-        [&](int value) { model_->setFilter(QString("rating>=%1").arg(value)); });
+        [&](int value) {
+            if (model_) {
+                model_->setFilter(QString("rating>=%1").arg(value));
+            }
+        });
 
     QSplitter* central = new QSplitter(Qt::Horizontal);
 
@@ -340,14 +563,14 @@ void MainWindow::createMainWidget()
 
     llayout->addWidget(file_view_label_);
     llayout->addLayout(top_llayout);
-    llayout->addWidget(file_view_);
+    llayout->addWidget(file_stack_);
 
     QWidget* lwid = new QWidget(this);
     lwid->setLayout(llayout);
     central->addWidget(lwid);
 
     QVBoxLayout* rlayout = new QVBoxLayout();
-    rlayout->addWidget(image_viewer_);
+    rlayout->addWidget(viewer_stack_);
 
     QWidget* rwid = new QWidget(this);
     rwid->setLayout(rlayout);
@@ -364,17 +587,216 @@ void MainWindow::createNewModel(const QString& path)
         model_ = nullptr;
     }
     auto db = openPicDatabase(path);
-    model_ = new PicModel(db, this);
     db_path_ = path;
+    attached_.clear();
+    createModel(db, kPicturesTable);
+    startMigration(path);
+}
+
+void MainWindow::startMigration(const QString& path)
+{
+    // the library is browsed while its indexes are built
+    auto migrator = new Migrator(path, this);
+    connect(
+        migrator,
+        &Migrator::progress,
+        this,
+        [this, path](int step, int nr_steps, const QString& description) {
+            statusBar()->showMessage(QString("Upgrading %1: %2 (%3/%4)")
+                                         .arg(path, description)
+                                         .arg(step + 1)
+                                         .arg(nr_steps));
+        });
+    connect(migrator, &Migrator::done, this, [this, migrator](bool success) {
+        if (success) {
+            statusBar()->clearMessage();
+        }
+        else {
+            statusBar()->showMessage(
+                QString("Failed to upgrade %1").arg(migrator->path()));
+        }
+        migrator->deleteLater();
+    });
+    migrator->start();
+}
+
+void MainWindow::saveSession()
+{
+    QSettings settings{kSettingsOrganization, kSettingsApplication};
+    settings.setValue(kSessionLibrary, db_path_);
+    settings.setValue(kSessionAttached, attached_);
+    settings.setValue(kSessionMinRating, filter_spin_box_->value());
+    settings.setValue(
+        kSessionGrid, file_stack_->currentWidget() == thumbnail_view_);
+
+    QVariantList ids;
+    QStringList pictures;
+    QVariantList rotations;
+    int nr_selected = 0;
+    int top_id = -1;
+    if (model_) {
+        nr_selected = file_view_->nrSelectedRows();
+        if (nr_selected <= kMaxSessionSelection) {
+            for (int row : file_view_->selectedRows()) {
+                ids.push_back(model_->index(row, PicModel::kColId).data());
+            }
+        }
+
+        auto selected = file_view_->selectedRows(1);
+        int row = selected.isEmpty() ? 0 : selected.front();
+        for (int neighbour : {row, row + 1, row - 1}) {
+            if (neighbour < 0 || neighbour >= model_->rowCount()) {
+                continue;
+            }
+            pictures.push_back(model_->index(neighbour, PicModel::kColPath)
+                                   .data()
+                                   .toString());
+            rotations.push_back(
+                model_->index(neighbour, PicModel::kColRotation).data());
+        }
+
+        int top = topRow();
+        if (top >= 0) {
+            top_id = model_->index(top, PicModel::kColId).data().toInt();
+        }
+    }
+    settings.setValue(
+        kSessionAllSelected,
+        nr_selected > 0 && model_ && nr_selected == model_->rowCount());
+    settings.setValue(kSessionSelectedIds, ids);
+    settings.setValue(kSessionTopId, top_id);
+    settings.setValue(kSessionPictures, pictures);
+    settings.setValue(kSessionRotations, rotations);
+}
+
+void MainWindow::restoreSession()
+{
+    TraceScope trace{"MainWindow::restoreSession"};
+    QSettings settings{kSettingsOrganization, kSettingsApplication};
+    const QString library = settings.value(kSessionLibrary).toString();
+    if (library.isEmpty() || !QFile::exists(library)) {
+        return;
+    }
+    qDebug() << "restoring" << library;
+
+    // decoded while the library is opened, the loaders have their threads
+    const QStringList pictures =
+        settings.value(kSessionPictures).toStringList();
+    const QVariantList rotations = settings.value(kSessionRotations).toList();
+    for (int i = 0; i < pictures.size(); ++i) {
+        if (i == 0) {
+            image_viewer_->setImagePath(
+                pictures[i], rotations.value(i).toInt());
+        }
+        else {
+            image_viewer_->preload(pictures[i], rotations.value(i).toInt());
+        }
+    }
+
+    restoring_session_ = true;
+    grid_action_->setChecked(settings.value(kSessionGrid).toBool());
+    filter_spin_box_->setValue(settings.value(kSessionMinRating).toInt());
+
+    auto db = openPicDatabase(library);
+    db_path_ = library;
+    attached_.clear();
+    // the libraries needing an upgrade since are left out, they are
+    // upgraded when the user attaches them again
+    QStringList outdated;
+    for (const auto& path : settings.value(kSessionAttached).toStringList()) {
+        if (libraryNeedsUpgrade(path)) {
+            outdated.push_back(path);
+        }
+        else if (attachLibrary(db, path, false)) {
+            attached_.push_back(path);
+        }
+    }
+    createModel(db, attached_.isEmpty() ? kPicturesTable : kAllPicturesView);
+    startMigration(library);
+    if (!outdated.isEmpty()) {
+        QMessageBox::information(
+            this,
+            "Upgrade library",
+            QString("These libraries were created by an older version of "
+                    "picpic, attach them again to upgrade them:\n%1")
+                .arg(outdated.join("\n")));
+    }
+
+    if (settings.value(kSessionAllSelected).toBool()) {
+        file_view_->selectAll();
+    }
+    else {
+        QSet<int> ids;
+        for (const auto& id : settings.value(kSessionSelectedIds).toList()) {
+            ids.insert(id.toInt());
+        }
+        QItemSelection selection;
+        for (int row : model_->rowsOfIds(ids)) {
+            selection.select(model_->index(row, 0), model_->index(row, 0));
+        }
+        file_view_->selectionModel()->select(
+            selection,
+            QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    }
+
+    int top = model_->rowsOfIds({settings.value(kSessionTopId).toInt()})
+                  .value(0, -1);
+    if (top >= 0) {
+        QAbstractItemView* view =
+            static_cast<QAbstractItemView*>(file_stack_->currentWidget());
+        view->scrollTo(
+            model_->index(top, PicModel::kColPath),
+            QAbstractItemView::PositionAtTop);
+    }
+
+    restoring_session_ = false;
+    updateLabel();
+    updateImage();
+}
+
+int MainWindow::topRow() const
+{
+    if (file_stack_->currentWidget() == file_view_) {
+        return file_view_->rowAt(0);
+    }
+    QSize grid = thumbnail_view_->gridSize();
+    return thumbnail_view_
+        ->indexAt(QPoint(grid.width() / 2, grid.height() / 2))
+        .row();
+}
+
+void MainWindow::createModel(QSqlDatabase db, const QString& table)
+{
+    model_ = new PicModel(db, table, scheduler_, this);
+    model_->setThumbnailSize(
+        file_stack_->currentWidget() == thumbnail_view_ ? kGridThumbnailSize
+                                                        : kListThumbnailSize);
+    if (filter_spin_box_->value() > 0) {
+        model_->setFilter(
+            QString("rating>=%1").arg(filter_spin_box_->value()));
+    }
 
     // Connect model
     connect(model_, &PicModel::modelReset, this, &MainWindow::updateLabel);
     connect(model_, &PicModel::modelReset, this, &MainWindow::updateImage);
+    connect(model_, &PicModel::writeFailed, this, [this](const QString& error) {
+        QMessageBox::warning(
+            this,
+            "Update error",
+            QString("The change could not be written to the library: %1")
+                .arg(error));
+    });
 
     // Update widgets that use the model
     file_view_->setModel(model_);
+    thumbnail_view_->setModel(model_);
     model_->select();
 
+    // both views share the same selection
+    QItemSelectionModel* thumbnail_selection = thumbnail_view_->selectionModel();
+    thumbnail_view_->setSelectionModel(file_view_->selectionModel());
+    delete thumbnail_selection;
+
     // Connect slection
     connect(
         file_view_->selectionModel(),
@@ -388,8 +810,11 @@ void MainWindow::createNewModel(const QString& path)
         &MainWindow::updateImage);
 
     // Enable buttons
+    attach_action_->setEnabled(true);
     scan_action_->setEnabled(true);
     export_action_->setEnabled(true);
+    analyze_action_->setEnabled(true);
+    xmp_action_->setEnabled(true);
 }
 
 void MainWindow::updateLabel()
@@ -403,12 +828,44 @@ void MainWindow::updateLabel()
         QString("Library: %1 - %2 files.\nSelected: %3")
             .arg(db_path_)
             .arg(QString::number(model_->rowCount()))
-            .arg(file_view_->selectedRows().size()));
+            .arg(file_view_->nrSelectedRows()));
 }
 
 void MainWindow::updateImage()
 {
-    auto selected = file_view_->selectedRows();
+    if (restoring_session_) {
+        return;
+    }
+    auto selected = file_view_->selectedRows(CompareView::kMaxPictures);
+    if (compare_mode_ && selected.size() > 1) {
+        QStringList paths;
+        QVector<int> rotations;
+        for (int row : selected) {
+            paths.push_back(
+                model_->index(row, PicModel::kColPath).data().toString());
+            rotations.push_back(
+                model_->index(row, PicModel::kColRotation).data().toInt());
+        }
+        qDebug() << "comparing" << paths;
+        viewer_stack_->setCurrentWidget(compare_view_);
+        compare_view_->setImagePaths(paths, rotations);
+
+        // next candidates, in case the user moves on to the next burst
+        QStringList next;
+        QVector<int> next_rotations;
+        for (int row = selected.last() + 1;
+             row < model_->rowCount() && next.size() < paths.size();
+             ++row) {
+            next.push_back(
+                model_->index(row, PicModel::kColPath).data().toString());
+            next_rotations.push_back(
+                model_->index(row, PicModel::kColRotation).data().toInt());
+        }
+        compare_view_->preload(next, next_rotations);
+        return;
+    }
+    viewer_stack_->setCurrentWidget(image_viewer_);
+
     int row = selected.empty() ? 0 : selected.front();
 
     QVariant data = model_->data(model_->index(row, PicModel::kColPath));
@@ -419,20 +876,21 @@ void MainWindow::updateImage()
 
     QString path = data.toString();
     qDebug() << "displaying" << path;
-    image_viewer_->setImagePath(path);
-
-    QVector<QVariant> neighbours;
-    neighbours.push_back(model_->data(model_->index(row + 1, PicModel::kColPath)));
-    neighbours.push_back(model_->data(model_->index(row - 1, PicModel::kColPath)));
+    image_viewer_->setImagePath(
+        path, model_->index(row, PicModel::kColRotation).data().toInt());
 
-    for (const auto& neighbour : neighbours) {
-        if (!neighbour.isValid()) {
+    for (int neighbour : {row + 1, row - 1}) {
+        QVariant data =
+            model_->data(model_->index(neighbour, PicModel::kColPath));
+        if (!data.isValid()) {
             continue;
         }
 
-        QString path = neighbour.toString();
+        QString path = data.toString();
         qDebug() << "preloading" << path;
-        image_viewer_->preload(path);
+        image_viewer_->preload(
+            path,
+            model_->index(neighbour, PicModel::kColRotation).data().toInt());
     }
 }
 
@@ -6,63 +6,94 @@
 #include <QMainWindow>
 #include <QMessageBox>
 #include <QProgressBar>
-#include <QProgressDialog>
 #include <QSpinBox>
-#include <QSqlTableModel>
+#include <QSqlDatabase>
+#include <QStackedWidget>
 #include <QTableView>
 
+#include "compare_view.hpp"
 #include "deleter.hpp"
 #include "exporter.hpp"
 #include "file_scanner.hpp"
 #include "file_view.hpp"
 #include "image_viewer.hpp"
 #include "inserter.hpp"
+#include "job_view.hpp"
+#include "jobs.hpp"
+#include "migrator.hpp"
+#include "perf_overlay.hpp"
 #include "pic_model.hpp"
+#include "pixmap_cache.hpp"
+#include "thumbnail_view.hpp"
 
 namespace picpic {
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
+signals:
+    // see ImageViewer::painted
+    void picturePainted(bool decoded);
 
 public:
     MainWindow();
     bool keyEvent(QKeyEvent* event);
 
+protected:
+    void closeEvent(QCloseEvent* event) override;
+
 private:
     void onNewAction();
     void onOpenAction();
+    void onAttachAction();
     void onScanAction();
     void onExportAction();
+    void onAnalyzeAction();
+    void onWriteXmpAction();
     void onHelpAction();
+    void onGridAction(bool enabled);
     void onDeleteSelection();
 
     void createActions();
     void createShortcuts();
     void createMainWidget();
     void createNewModel(const QString& path);
+    void createModel(QSqlDatabase db, const QString& table);
+    void startMigration(const QString& path);
+    // The library, filter, selection and position of the last session are
+    // stored in QSettings when the window is closed
+    void saveSession();
+    void restoreSession();
+    int topRow() const;
 
     void updateLabel();
     void updateImage();
 
     QString db_path_;
+    QStringList attached_;
+    // the picture of the last session is shown meanwhile
+    bool restoring_session_{false};
     PicModel* model_{nullptr};
+    PixmapCache pixmap_cache_;
+    QStackedWidget* viewer_stack_{nullptr};
     ImageViewer* image_viewer_{nullptr};
+    CompareView* compare_view_{nullptr};
+    bool compare_mode_{false};
+    PerfOverlay* perf_overlay_{nullptr};
 
+    QStackedWidget* file_stack_{nullptr};
     FileView* file_view_{nullptr};
+    ThumbnailView* thumbnail_view_{nullptr};
     QLabel* file_view_label_{nullptr};
     QSpinBox* filter_spin_box_{nullptr};
 
+    QAction* attach_action_{nullptr};
     QAction* scan_action_{nullptr};
     QAction* export_action_{nullptr};
+    QAction* analyze_action_{nullptr};
+    QAction* xmp_action_{nullptr};
+    QAction* grid_action_{nullptr};
 
-    QProgressDialog* export_modal_{nullptr};
-    Exporter* exporter_{nullptr};
-
-    QProgressDialog* delete_modal_{nullptr};
-    Deleter* deleter_{nullptr};
-
-    QProgressDialog* scan_modal_{nullptr};
-    Inserter* inserter_{nullptr};
+    JobScheduler* scheduler_{nullptr};
 };
 
 } // picpic
@@ -0,0 +1,57 @@
+#include "mapped_file.hpp"
+
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+namespace picpic {
+
+MappedFile::MappedFile(const QString& path) : file_{path}
+{
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    size_ = file_.size();
+    // QByteArray sizes are ints
+    if (size_ > 0 && size_ <= std::numeric_limits<int>::max()) {
+        data_ = file_.map(0, size_);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_) {
+        file_.unmap(data_);
+    }
+#ifdef __linux__
+    // only pages that are not mapped anymore can be dropped
+    if (drop_from_cache_ && file_.isOpen()) {
+        posix_fadvise(file_.handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+}
+
+QByteArray MappedFile::bytes() const
+{
+    if (!data_) {
+        return {};
+    }
+    return QByteArray::fromRawData(
+        reinterpret_cast<const char*>(data_), int(size_));
+}
+
+void MappedFile::adviseSequential()
+{
+#ifndef _WIN32
+    if (data_) {
+        // the mapping starts at offset 0, it is page aligned
+        madvise(data_, size_, MADV_SEQUENTIAL);
+        madvise(data_, size_, MADV_WILLNEED);
+    }
+#endif
+}
+
+} // picpic
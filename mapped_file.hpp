@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+namespace picpic {
+
+// Read-only memory mapping of a whole file, with hints to the kernel about
+// how it is read. Hints do nothing where they are not supported.
+class MappedFile {
+public:
+    explicit MappedFile(const QString& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isMapped() const { return data_ != nullptr; }
+    const uchar* data() const { return data_; }
+    qint64 size() const { return size_; }
+    // Mapped bytes without a copy, only valid as long as this object
+    QByteArray bytes() const;
+
+    // The file is about to be read once, from start to end: read it ahead
+    // in large chunks
+    void adviseSequential();
+    // Drop the pages of the file from the page cache on destruction, it is
+    // not expected to be read again soon
+    void setDropFromCache(bool drop) { drop_from_cache_ = drop; }
+
+private:
+    QFile file_;
+    uchar* data_{nullptr};
+    qint64 size_{0};
+    bool drop_from_cache_{false};
+};
+
+} // picpic
@@ -0,0 +1,357 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QtEndian>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) \
+    || defined(_M_IX86)
+#define PICPIC_METRICS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PICPIC_METRICS_NEON
+#include <arm_neon.h>
+#endif
+
+// instructions sets are enabled per function, the rest of the program does
+// not require them
+#if defined(PICPIC_METRICS_X86) && defined(__GNUC__)
+#define PICPIC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PICPIC_TARGET(isa)
+#endif
+
+#include "resample.hpp"
+#include "thumbnail_cache.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+// luminance weights in fixed point, they fit in the signed 8 bits operand
+// of _mm_maddubs_epi16
+constexpr int kLumaBits = 7;
+constexpr int kRedWeight = 38;
+constexpr int kGreenWeight = 75;
+constexpr int kBlueWeight = 15;
+// luminances counted as clipped
+constexpr int kShadowLevel = 3;
+constexpr int kHighlightLevel = 252;
+constexpr int kMaxHistogramValue = 65535;
+
+// Row kernels, with one version per instruction set. Samples are 8 bits
+// luminances.
+//
+// luma: dst[i] = luminance of src[i]
+// laplacian: adds the Laplacian of row at [1, n - 1) and its square to sum
+// and sum_squares, above and below are the neighbouring rows. The rows are
+// at most a thumbnail wide: the 32 bits lanes of the vector versions
+// cannot overflow.
+struct Kernels {
+    void (*luma)(const QRgb* src, uchar* dst, int n);
+    void (*laplacian)(
+        const uchar* above,
+        const uchar* row,
+        const uchar* below,
+        int n,
+        qint64* sum,
+        qint64* sum_squares);
+    const char* name;
+};
+
+void lumaScalar(const QRgb* src, uchar* dst, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        dst[i] = (qRed(src[i]) * kRedWeight + qGreen(src[i]) * kGreenWeight
+                  + qBlue(src[i]) * kBlueWeight)
+                 >> kLumaBits;
+    }
+}
+
+void laplacianRange(
+    const uchar* above,
+    const uchar* row,
+    const uchar* below,
+    int begin,
+    int end,
+    qint64* sum,
+    qint64* sum_squares)
+{
+    for (int i = begin; i < end; ++i) {
+        int laplacian =
+            4 * row[i] - row[i - 1] - row[i + 1] - above[i] - below[i];
+        *sum += laplacian;
+        *sum_squares += laplacian * laplacian;
+    }
+}
+
+void laplacianScalar(
+    const uchar* above,
+    const uchar* row,
+    const uchar* below,
+    int n,
+    qint64* sum,
+    qint64* sum_squares)
+{
+    laplacianRange(above, row, below, 1, n - 1, sum, sum_squares);
+}
+
+#if defined(PICPIC_METRICS_X86)
+
+// Pixels are B, G, R, A bytes in memory: maddubs gives B * wb + G * wg and
+// R * wr of each pixel, which hadd adds together.
+PICPIC_TARGET("sse4.1")
+void lumaSse41(const QRgb* src, uchar* dst, int n)
+{
+    const __m128i weights =
+        _mm_set1_epi32(kBlueWeight | kGreenWeight << 8 | kRedWeight << 16);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_maddubs_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+            weights);
+        __m128i b = _mm_maddubs_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)),
+            weights);
+        __m128i luma = _mm_srli_epi16(_mm_hadd_epi16(a, b), kLumaBits);
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(luma, luma));
+    }
+    lumaScalar(src + i, dst + i, n - i);
+}
+
+PICPIC_TARGET("sse4.1")
+__m128i loadSamples(const uchar* src)
+{
+    return _mm_cvtepu8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+}
+
+PICPIC_TARGET("sse4.1")
+qint64 addLanes(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+// The Laplacian fits in 16 bits, madd adds its values and its squares by
+// pairs into 32 bits lanes.
+PICPIC_TARGET("sse4.1")
+void laplacianSse41(
+    const uchar* above,
+    const uchar* row,
+    const uchar* below,
+    int n,
+    qint64* sum,
+    qint64* sum_squares)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sums = _mm_setzero_si128();
+    __m128i squares = _mm_setzero_si128();
+    int i = 1;
+    for (; i + 9 <= n; i += 8) {
+        __m128i neighbours = _mm_add_epi16(
+            _mm_add_epi16(loadSamples(row + i - 1), loadSamples(row + i + 1)),
+            _mm_add_epi16(loadSamples(above + i), loadSamples(below + i)));
+        __m128i laplacian = _mm_sub_epi16(
+            _mm_slli_epi16(loadSamples(row + i), 2), neighbours);
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(laplacian, ones));
+        squares = _mm_add_epi32(squares, _mm_madd_epi16(laplacian, laplacian));
+    }
+    *sum += addLanes(sums);
+    *sum_squares += addLanes(squares);
+    laplacianRange(above, row, below, i, n - 1, sum, sum_squares);
+}
+
+#endif // PICPIC_METRICS_X86
+
+#if defined(PICPIC_METRICS_NEON)
+
+void lumaNeon(const QRgb* src, uchar* dst, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // deinterleaved into B, G, R and A
+        uint8x8x4_t bgra = vld4_u8(reinterpret_cast<const uchar*>(src + i));
+        uint16x8_t luma = vmull_u8(bgra.val[0], vdup_n_u8(kBlueWeight));
+        luma = vmlal_u8(luma, bgra.val[1], vdup_n_u8(kGreenWeight));
+        luma = vmlal_u8(luma, bgra.val[2], vdup_n_u8(kRedWeight));
+        vst1_u8(dst + i, vshrn_n_u16(luma, kLumaBits));
+    }
+    lumaScalar(src + i, dst + i, n - i);
+}
+
+int16x8_t loadSamples(const uchar* src)
+{
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src)));
+}
+
+qint64 addLanes(int32x4_t v)
+{
+    return qint64(vgetq_lane_s32(v, 0)) + vgetq_lane_s32(v, 1)
+           + vgetq_lane_s32(v, 2) + vgetq_lane_s32(v, 3);
+}
+
+void laplacianNeon(
+    const uchar* above,
+    const uchar* row,
+    const uchar* below,
+    int n,
+    qint64* sum,
+    qint64* sum_squares)
+{
+    int32x4_t sums = vdupq_n_s32(0);
+    int32x4_t squares = vdupq_n_s32(0);
+    int i = 1;
+    for (; i + 9 <= n; i += 8) {
+        int16x8_t neighbours = vaddq_s16(
+            vaddq_s16(loadSamples(row + i - 1), loadSamples(row + i + 1)),
+            vaddq_s16(loadSamples(above + i), loadSamples(below + i)));
+        int16x8_t laplacian =
+            vsubq_s16(vshlq_n_s16(loadSamples(row + i), 2), neighbours);
+        sums = vpadalq_s16(sums, laplacian);
+        squares = vmlal_s16(
+            squares, vget_low_s16(laplacian), vget_low_s16(laplacian));
+        squares = vmlal_s16(
+            squares, vget_high_s16(laplacian), vget_high_s16(laplacian));
+    }
+    *sum += addLanes(sums);
+    *sum_squares += addLanes(squares);
+    laplacianRange(above, row, below, i, n - 1, sum, sum_squares);
+}
+
+#endif // PICPIC_METRICS_NEON
+
+Kernels detectKernels()
+{
+#if defined(PICPIC_METRICS_X86)
+    bool sse41 = false;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 1) {
+        __cpuid(info, 1);
+        sse41 = info[2] & (1 << 19);
+    }
+#else
+    __builtin_cpu_init();
+    sse41 = __builtin_cpu_supports("sse4.1");
+#endif
+    if (sse41) {
+        return {lumaSse41, laplacianSse41, "sse4.1"};
+    }
+#elif defined(PICPIC_METRICS_NEON)
+    return {lumaNeon, laplacianNeon, "neon"};
+#endif
+    return {lumaScalar, laplacianScalar, "scalar"};
+}
+
+const Kernels& kernels()
+{
+    static const Kernels detected = detectKernels();
+    return detected;
+}
+
+QByteArray histogramBlob(const PictureMetrics& metrics)
+{
+    // little endian 16 bits bins
+    QByteArray blob(
+        PictureMetrics::kHistogramBins * sizeof(quint16), Qt::Uninitialized);
+    for (int bin = 0; bin < PictureMetrics::kHistogramBins; ++bin) {
+        qToLittleEndian<quint16>(
+            metrics.histogram[bin], blob.data() + bin * sizeof(quint16));
+    }
+    return blob;
+}
+
+} // <anonymous>
+
+PictureMetrics computeMetrics(const QImage& image)
+{
+    TraceScope trace{"computeMetrics"};
+    PictureMetrics metrics;
+    if (image.isNull()) {
+        return metrics;
+    }
+
+    QImage src = image;
+    const QSize bound{kThumbnailCacheSize, kThumbnailCacheSize};
+    if (src.width() > bound.width() || src.height() > bound.height()) {
+        src = resample(src, src.size().scaled(bound, Qt::KeepAspectRatio));
+    }
+    if (src.format() != QImage::Format_RGB32
+        && src.format() != QImage::Format_ARGB32
+        && src.format() != QImage::Format_ARGB32_Premultiplied) {
+        src = src.convertToFormat(QImage::Format_RGB32);
+    }
+
+    const Kernels& k = kernels();
+    const int width = src.width();
+    const int height = src.height();
+    std::vector<uchar> luma(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; ++y) {
+        k.luma(
+            reinterpret_cast<const QRgb*>(src.constScanLine(y)),
+            luma.data() + y * width,
+            width);
+    }
+
+    int counts[256]{};
+    for (uchar value : luma) {
+        ++counts[value];
+    }
+    const qint64 nr_pixels = static_cast<qint64>(luma.size());
+    qint64 clipped = 0;
+    for (int value = 0; value < 256; ++value) {
+        if (value <= kShadowLevel || value >= kHighlightLevel) {
+            clipped += counts[value];
+        }
+    }
+    metrics.clipped = float(100. * clipped / nr_pixels);
+    constexpr int kValuesPerBin = 256 / PictureMetrics::kHistogramBins;
+    for (int bin = 0; bin < PictureMetrics::kHistogramBins; ++bin) {
+        qint64 count = 0;
+        for (int value = 0; value < kValuesPerBin; ++value) {
+            count += counts[bin * kValuesPerBin + value];
+        }
+        metrics.histogram[bin] = static_cast<quint16>(
+            (count * kMaxHistogramValue + nr_pixels / 2) / nr_pixels);
+    }
+
+    // the border pixels have no Laplacian
+    if (width < 3 || height < 3) {
+        return metrics;
+    }
+    qint64 sum = 0;
+    qint64 sum_squares = 0;
+    for (int y = 1; y + 1 < height; ++y) {
+        const uchar* row = luma.data() + y * width;
+        k.laplacian(row - width, row, row + width, width, &sum, &sum_squares);
+    }
+    const double n = double(width - 2) * (height - 2);
+    const double mean = sum / n;
+    metrics.sharpness = float(std::max(0., sum_squares / n - mean * mean));
+    return metrics;
+}
+
+const char* metricsInstructionSet()
+{
+    return kernels().name;
+}
+
+void bindMetrics(QSqlQuery& query, const PictureMetrics& metrics)
+{
+    // the SQLite driver binds doubles, not floats
+    query.addBindValue(double(metrics.sharpness));
+    query.addBindValue(double(metrics.clipped));
+    query.addBindValue(histogramBlob(metrics));
+}
+
+} // picpic
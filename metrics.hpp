@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+
+#include <QByteArray>
+#include <QImage>
+#include <QMetaType>
+#include <QSqlQuery>
+
+namespace picpic {
+
+// Quality of a picture, to sort or filter out the blurry and badly exposed
+// ones. It is computed on the thumbnail of the picture: the metrics of
+// pictures of different sizes compare, and they cost little next to the
+// decode which produced it.
+struct PictureMetrics {
+    static constexpr int kHistogramBins = 32;
+
+    // variance of the Laplacian of the luminance, low for blurry pictures
+    float sharpness{0};
+    // percentage of the pixels with a luminance close to black or white:
+    // blocked shadows or blown highlights
+    float clipped{0};
+    // of the luminance, bins hold a fraction of the pixels in 1/65535
+    std::array<quint16, kHistogramBins> histogram{};
+};
+
+// Images larger than a thumbnail are reduced first. Kernels use SSE4.1 or
+// NEON when the CPU has them.
+PictureMetrics computeMetrics(const QImage& image);
+
+// Instruction set the metrics kernels use on this CPU
+const char* metricsInstructionSet();
+
+// Columns of the libraries holding the metrics, NULL until computed: the
+// assignments of an UPDATE, their values are bound by bindMetrics
+constexpr const char* kMetricsAssignments =
+    "sharpness = ?, clipped = ?, histogram = ?";
+void bindMetrics(QSqlQuery& query, const PictureMetrics& metrics);
+
+} // picpic
+
+Q_DECLARE_METATYPE(picpic::PictureMetrics)
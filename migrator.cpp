@@ -0,0 +1,44 @@
+#include "migrator.hpp"
+
+#include <QSqlDatabase>
+
+#include "database.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+Migrator::Migrator(QString path, QObject* parent)
+    : QThread(parent), path_{std::move(path)}
+{
+}
+
+Migrator::~Migrator()
+{
+    wait();
+}
+
+void Migrator::run()
+{
+    TraceScope trace{"Migrator::run"};
+    // connections can only be used by the thread which created them
+    const QString connection =
+        QString("migration_%1").arg(reinterpret_cast<quintptr>(this));
+    bool success = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection);
+        db.setDatabaseName(path_);
+        if (db.open()) {
+            success = migratePicDatabase(
+                db,
+                "main",
+                true,
+                [this](int step, int nr_steps, const QString& description) {
+                    progress(step, nr_steps, description);
+                });
+        }
+    }
+    QSqlDatabase::removeDatabase(connection);
+    done(success);
+}
+
+} // picpic
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QThread>
+
+namespace picpic {
+
+// Applies the migrations left by openPicDatabase on its own connection to
+// the library: the library is browsed meanwhile, SQLite readers are not
+// blocked by the index builds.
+class Migrator : public QThread {
+    Q_OBJECT
+signals:
+    void progress(int step, int nr_steps, QString description);
+    void done(bool success);
+
+public:
+    Migrator(QString path, QObject* parent = nullptr);
+    // a migration being applied is not interrupted
+    ~Migrator() override;
+    const QString& path() const { return path_; }
+
+protected:
+    void run() override;
+
+private:
+    const QString path_;
+};
+
+} // picpic
@@ -0,0 +1,96 @@
+#include "perf_overlay.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QVector>
+
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kRefreshMs = 500;
+// latencies are computed over the most recent decodes
+constexpr int kLatencySamples = 64;
+
+QString hitRate(Counter hits, Counter misses)
+{
+    qint64 nr_hits = counterValue(hits);
+    qint64 total = nr_hits + counterValue(misses);
+    if (total == 0) {
+        return "-";
+    }
+    return QString("%1%").arg(100 * nr_hits / total);
+}
+
+} // <anonymous>
+
+PerfOverlay::PerfOverlay(QWidget* parent) : QLabel(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAutoFillBackground(true);
+    setStyleSheet(
+        "background-color: rgba(0, 0, 0, 160); color: white; padding: 4px;");
+    setFont(QFont("monospace"));
+
+    timer_.setInterval(kRefreshMs);
+    connect(&timer_, &QTimer::timeout, this, &PerfOverlay::refresh);
+    hide();
+}
+
+void PerfOverlay::showEvent(QShowEvent* event)
+{
+    was_tracing_ = tracingEnabled();
+    setTracingEnabled(true);
+    timer_.start();
+    refresh();
+    raise();
+    QLabel::showEvent(event);
+}
+
+void PerfOverlay::hideEvent(QHideEvent* event)
+{
+    timer_.stop();
+    setTracingEnabled(was_tracing_);
+    QLabel::hideEvent(event);
+}
+
+void PerfOverlay::refresh()
+{
+    QVector<double> latencies;
+    QVector<TraceEvent> events = traceEvents();
+    for (auto it = events.rbegin();
+         it != events.rend() && latencies.size() < kLatencySamples;
+         ++it) {
+        if (std::strcmp(it->name, kDecodeTrace) == 0) {
+            latencies.push_back(it->duration_ns / 1e6);
+        }
+    }
+
+    QString latency = "-";
+    if (!latencies.isEmpty()) {
+        std::sort(latencies.begin(), latencies.end());
+        latency =
+            QString("p50 %1 ms, p90 %2 ms")
+                .arg(latencies[latencies.size() / 2], 0, 'f', 1)
+                .arg(latencies[latencies.size() * 9 / 10], 0, 'f', 1);
+    }
+
+    setText(
+        QString("decode:           %1\n"
+                "pixmap cache:     %2 hits\n"
+                "thumbnail cache:  %3 hits\n"
+                "loader queues:    %4")
+            .arg(latency)
+            .arg(hitRate(
+                Counter::kPixmapCacheHits, Counter::kPixmapCacheMisses))
+            .arg(hitRate(
+                Counter::kThumbnailCacheHits, Counter::kThumbnailCacheMisses))
+            .arg(counterValue(Counter::kLoaderQueueDepth)));
+    adjustSize();
+    move(0, 0);
+}
+
+} // picpic
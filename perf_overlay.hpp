@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QLabel>
+#include <QTimer>
+
+namespace picpic {
+
+// Shows decode latency, cache hit rates and the loader queue depth over its
+// parent. Tracing is enabled while it is visible, the latencies come from
+// the trace events.
+class PerfOverlay : public QLabel {
+    Q_OBJECT
+public:
+    PerfOverlay(QWidget* parent);
+
+protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+private:
+    void refresh();
+
+    QTimer timer_;
+    bool was_tracing_{false};
+};
+
+} // picpic
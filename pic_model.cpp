@@ -1,123 +1,571 @@
 #include "pic_model.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include <QBrush>
 #include <QColor>
 #include <QFile>
-#include <QSqlRecord>
+#include <QSet>
+
+#include "rater.hpp"
+#include "rotator.hpp"
+#include "trace.hpp"
 
 namespace picpic {
 
 namespace {
 
-constexpr int kThumbnailSize = 32;
-constexpr const char* kPicturesConnectionName = "pictures";
-constexpr const char* kPicturesTable = "pictures";
-constexpr const char* kPicturesTableCreationQuery =
-    "create table pictures ("
-    "id integer primary key, "
-    "path varchar(4096) unique, "
-    "rating tinyint"
-    ")";
+constexpr int kMaxPendingThumbnails = 256;
+constexpr int kThumbnailsCacheKb = 64 * 1024;
+constexpr int kNotifyIntervalMs = 16;
+constexpr int kMetricsIntervalMs = 1000;
+constexpr const char* kColumnNames[] =
+    {"id", "path", "rating", "rotation", "sharpness", "clipped"};
+
 }
 
-QSqlDatabase openPicDatabase(const QString& path)
+PicModel::PicModel(
+    QSqlDatabase db,
+    const QString& table,
+    JobScheduler* scheduler,
+    QObject* parent)
+    : QAbstractTableModel(parent),
+      db_{db},
+      table_{table},
+      scheduler_{scheduler},
+      loader_(kMaxPendingThumbnails),
+      thumbnails_(kThumbnailsCacheKb)
 {
-    if (QSqlDatabase::contains(kPicturesConnectionName)) {
-        QSqlDatabase::removeDatabase(kPicturesConnectionName);
+    if (table == kAllPicturesView) {
+        // the libraries are scanned in path order and merged
+        sort_column_ = kColPath;
     }
 
-    QSqlDatabase db =
-        QSqlDatabase::addDatabase("QSQLITE", kPicturesConnectionName);
-    db.setDatabaseName(path);
-    if (db.open()) {
-        if (!db.tables().contains(kPicturesTable)) {
-            QSqlQuery query(db);
-            if (!query.exec(kPicturesTableCreationQuery)) {
-                qDebug() << "failed to create pictures table:"
-                         << query.lastError().text();
+    notify_timer_.setSingleShot(true);
+    notify_timer_.setInterval(kNotifyIntervalMs);
+    connect(
+        &notify_timer_, &QTimer::timeout, this, &PicModel::notifyThumbnails);
+
+    connect(
+        &loader_,
+        &ImageLoader::imageLoaded,
+        this,
+        [this](
+            const QString&,
+            const QImage& image,
+            QSize size,
+            int rotation,
+            int id) {
+            if (size != QSize(thumbnail_size_, thumbnail_size_)) {
+                // requested before the thumbnail size changed
+                return;
             }
-            else {
-                qDebug() << "created pictures table";
+            onThumbnailLoaded(QPixmap::fromImage(image), rotation, id);
+        });
+    metrics_timer_.setSingleShot(true);
+    metrics_timer_.setInterval(kMetricsIntervalMs);
+    connect(&metrics_timer_, &QTimer::timeout, this, &PicModel::writeMetrics);
+
+    connect(
+        &loader_,
+        &ImageLoader::metricsComputed,
+        this,
+        [this](const QString&, const PictureMetrics& metrics, int id) {
+            onMetricsComputed(metrics, id);
+        });
+    connect(
+        &loader_,
+        &ImageLoader::requestDropped,
+        this,
+        [this](const QString&, int id) {
+            // requested again the next time it is painted
+            pending_thumbnails_.remove(id);
+        });
+    loader_.setThumbnailCacheEnabled(true);
+    // the pictures are read again from the thumbnail cache, not the files
+    loader_.setDropFromPageCache(true);
+    loader_.setPrefetchEnabled(true);
+    loader_.setMetricsEnabled(true);
+    loader_.start();
+}
+
+PicModel::~PicModel()
+{
+    // the writer running finishes on its own, its failures are lost
+    if (scheduler_ && !pending_metrics_.isEmpty()) {
+        scheduler_->add(new MetricsWriter(db_, pending_metrics_), false);
+    }
+}
+
+bool PicModel::select()
+{
+    TraceScope trace{"PicModel::select"};
+    QString statement = QString("SELECT %1, %2, %3, %4, %5, %6 FROM %7")
+                            .arg(kColumnNames[kColId])
+                            .arg(kColumnNames[kColPath])
+                            .arg(kColumnNames[kColRating])
+                            .arg(kColumnNames[kColRotation])
+                            .arg(kColumnNames[kColSharpness])
+                            .arg(kColumnNames[kColClipped])
+                            .arg(table_);
+    if (!filter_.isEmpty()) {
+        statement += " WHERE " + filter_;
+    }
+    if (sort_column_ >= 0) {
+        statement += QString(" ORDER BY %1 %2")
+                         .arg(kColumnNames[sort_column_])
+                         .arg(sort_order_ == Qt::AscendingOrder ? "ASC"
+                                                                : "DESC");
+    }
+
+    // the rows are copied to the store, the query does not keep them
+    QSqlQuery query(db_);
+    query.setForwardOnly(true);
+
+    beginResetModel();
+    selected_ = true;
+    rows_.clear();
+    max_ids_.clear();
+    bool view = table_ == kAllPicturesView;
+    bool success = query.exec(statement);
+    if (success) {
+        while (query.next()) {
+            int id = query.value(kColId).toInt();
+            int library = view ? libraryIndex(id) : 0;
+            while (library >= max_ids_.size()) {
+                max_ids_.push_back(-1);
+            }
+            max_ids_[library] = std::max(
+                max_ids_[library], view ? libraryId(id) : id);
+            QVariant sharpness = query.value(kColSharpness);
+            QVariant clipped = query.value(kColClipped);
+            float sharpness_value = std::numeric_limits<float>::quiet_NaN();
+            float clipped_value = -1;
+            if (!sharpness.isNull()) {
+                sharpness_value = sharpness.toFloat();
+                clipped_value = clipped.isNull() ? -1.f : clipped.toFloat();
             }
+            else if (const AnalyzedPicture* computed = unwrittenMetrics(id)) {
+                // computed but not written yet
+                sharpness_value = computed->metrics.sharpness;
+                clipped_value = computed->metrics.clipped;
+            }
+            rows_.append(
+                id,
+                query.value(kColPath).toString(),
+                query.value(kColRating).toInt(),
+                query.value(kColRotation).toInt(),
+                sharpness_value,
+                clipped_value);
         }
+        rows_.squeeze();
+        rows_match_filter_ = true;
+        last_error_ = QSqlError();
     }
-    return db;
+    else {
+        last_error_ = query.lastError();
+        qDebug() << "failed to select pictures:" << last_error_.text();
+    }
+    endResetModel();
+    return success;
 }
 
-PicModel::PicModel(QSqlDatabase db, QObject* parent)
-    : QSqlTableModel(parent, db)
+void PicModel::setFilter(const QString& filter)
 {
-    setTable(kPicturesTable);
-    setEditStrategy(QSqlTableModel::OnFieldChange);
-    setHeaderData(kColId, Qt::Horizontal, "ID");
-    setHeaderData(kColPath, Qt::Horizontal, "Path");
-    setHeaderData(kColRating, Qt::Horizontal, "Rating");
+    filter_ = filter;
+    if (selected_) {
+        select();
+    }
+}
 
-    connect(
-        &loader_,
-        &ImageLoader::pixmapLoaded,
-        this,
-        [this](const QString& path, const QPixmap& pixmap) {
-            thumbnails_[path] = pixmap;
-            const QModelIndex& index = loading_indices_[path];
-            dataChanged(index, index, {Qt::DecorationRole});
-            loading_indices_.remove(path);
-        });
-    loader_.start();
+void PicModel::sort(int column, Qt::SortOrder order)
+{
+    if (column < 0 || column >= kNrColumns) {
+        return;
+    }
+    sort_column_ = column;
+    sort_order_ = order;
+    if (selected_) {
+        select();
+    }
 }
 
-bool PicModel::insert(const QString& path, int rating)
+Selection PicModel::selection(const QVector<QPair<int, int>>& rows) const
 {
-    if (!match(index(0, kColPath), Qt::DisplayRole, path).empty()) {
-        return true;
+    int nr_rows = 0;
+    for (const auto& range : rows) {
+        nr_rows += range.second - range.first + 1;
+    }
+    if (nr_rows > 0 && nr_rows == rowCount() && rows_match_filter_) {
+        return Selection::matching(table_, filter_, nr_rows, max_ids_);
     }
 
-    QSqlRecord record = this->record();
-    record.setValue(kColRating, rating);
-    record.setValue(kColPath, path);
-    return insertRecord(-1, record);
+    QVector<int> ids;
+    ids.reserve(nr_rows);
+    for (const auto& range : rows) {
+        for (int row = range.first; row <= range.second; ++row) {
+            ids.push_back(rows_.id(row));
+        }
+    }
+    return Selection::withIds(table_, std::move(ids));
+}
+
+QVector<int> PicModel::rowsOfIds(const QSet<int>& ids) const
+{
+    QVector<int> rows;
+    for (int row = 0; row < rows_.size() && rows.size() < ids.size(); ++row) {
+        if (ids.contains(rows_.id(row))) {
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+template <typename T>
+void PicModel::write(T* job)
+{
+    connect(job, &Job::finished, this, [this, job](bool success) {
+        if (!success && !job->isCancelled()) {
+            qDebug() << job->name() << "failed:" << job->errorString();
+            select();
+            writeFailed(job->errorString());
+        }
+    });
+    scheduler_->add(job, false);
+}
+
+void PicModel::rate(const QVector<QPair<int, int>>& rows, int rating)
+{
+    Selection selection = this->selection(rows);
+    if (selection.isEmpty() || !scheduler_) {
+        return;
+    }
+    write(new Rater(db_, selection, rating));
+
+    rows_match_filter_ &= filter_.isEmpty();
+    for (const auto& range : rows) {
+        for (int row = range.first; row <= range.second; ++row) {
+            rows_.setRating(row, rating);
+        }
+        dataChanged(
+            index(range.first, kColRating), index(range.second, kColRating));
+    }
+}
+
+void PicModel::rotate(const QVector<QPair<int, int>>& rows, int turns)
+{
+    Selection selection = this->selection(rows);
+    if (selection.isEmpty() || !scheduler_) {
+        return;
+    }
+    write(new Rotator(db_, selection, turns));
+
+    for (const auto& range : rows) {
+        for (int row = range.first; row <= range.second; ++row) {
+            int rotation = (rows_.rotation(row) + turns) % 4;
+            rows_.setRotation(row, rotation < 0 ? rotation + 4 : rotation);
+            // the thumbnail is reloaded with the new rotation on next paint
+            thumbnails_.remove(rows_.id(row));
+        }
+        dataChanged(
+            index(range.first, kColRotation),
+            index(range.second, kColRotation));
+        dataChanged(
+            index(range.first, kColPath),
+            index(range.second, kColPath),
+            {Qt::DecorationRole});
+    }
+}
+
+void PicModel::setThumbnailSize(int size)
+{
+    if (size == thumbnail_size_) {
+        return;
+    }
+    thumbnail_size_ = size;
+    thumbnails_.clear();
+    pending_thumbnails_.clear();
+    loader_.cancel([](int) { return true; });
+    if (rowCount() > 0) {
+        dataChanged(
+            index(0, kColPath),
+            index(rowCount() - 1, kColPath),
+            {Qt::DecorationRole});
+    }
+}
+
+void PicModel::setVisibleRows(int first, int last)
+{
+    // keep one screen before and after the visible rows
+    int count = last - first + 1;
+    int keep_first = first - count;
+    int keep_last = last + count;
+
+    QSet<int> cancelled;
+    for (auto it = pending_thumbnails_.begin();
+         it != pending_thumbnails_.end();) {
+        if (it->row < keep_first || it->row > keep_last) {
+            cancelled.insert(it.key());
+            it = pending_thumbnails_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    if (!cancelled.isEmpty()) {
+        // the predicate runs later on the loader thread
+        loader_.cancel(
+            [cancelled](int id) { return cancelled.contains(id); });
+    }
+
+    // the next screen first, it is the most likely to be shown
+    prefetchThumbnails(last + 1, keep_last);
+    prefetchThumbnails(keep_first, first - 1);
+}
+
+void PicModel::prefetchThumbnails(int first, int last)
+{
+    first = std::max(first, 0);
+    last = std::min(last, rowCount() - 1);
+    for (int row = first; row <= last; ++row) {
+        data(index(row, kColPath), Qt::DecorationRole);
+    }
+}
+
+void PicModel::onThumbnailLoaded(const QPixmap& pixmap, int rotation, int id)
+{
+    auto it = pending_thumbnails_.find(id);
+    if (it == pending_thumbnails_.end() || it->rotation != rotation) {
+        // cancelled, or rotated while loading and requested again
+        return;
+    }
+    int row = it->row;
+    pending_thumbnails_.erase(it);
+
+    int kb = pixmap.width() * pixmap.height() * pixmap.depth() / 8 / 1024;
+    thumbnails_.insert(id, new QPixmap(pixmap), std::max(kb, 1));
+
+    // the row is refreshed whenever the thumbnail is requested, if the
+    // model changed since then the views will request it again anyway
+    if (row >= rowCount() || rows_.id(row) != id) {
+        return;
+    }
+    first_loaded_row_ =
+        first_loaded_row_ < 0 ? row : std::min(first_loaded_row_, row);
+    last_loaded_row_ = std::max(last_loaded_row_, row);
+    if (!notify_timer_.isActive()) {
+        notify_timer_.start();
+    }
+}
+
+void PicModel::onMetricsComputed(const PictureMetrics& metrics, int id)
+{
+    // emitted before the thumbnail is loaded, it is still pending
+    auto it = pending_thumbnails_.find(id);
+    if (it == pending_thumbnails_.end()) {
+        return;
+    }
+    int row = it->row;
+    if (row >= rowCount() || rows_.id(row) != id || rows_.hasMetrics(row)) {
+        return;
+    }
+
+    rows_match_filter_ &= filter_.isEmpty();
+    rows_.setMetrics(row, metrics.sharpness, metrics.clipped);
+    dataChanged(index(row, kColSharpness), index(row, kColClipped));
+    pending_metrics_.insert(id, {rows_.path(row), metrics});
+    if (!metrics_timer_.isActive()) {
+        metrics_timer_.start();
+    }
+}
+
+void PicModel::writeMetrics()
+{
+    // the writer running starts the timer again when it is done
+    if (pending_metrics_.isEmpty() || !writing_metrics_.isEmpty()
+        || !scheduler_) {
+        return;
+    }
+
+    // the libraries may be locked for a while, by a migration or a job:
+    // they are written on the database thread, never on this one
+    writing_metrics_.swap(pending_metrics_);
+    auto writer = new MetricsWriter(db_, writing_metrics_);
+    connect(writer, &Job::finished, this, [this, writer](bool) {
+        // the failures are written again on the next tick, unless they
+        // were computed again meanwhile
+        const QHash<int, AnalyzedPicture>& failed = writer->failed();
+        for (auto it = failed.begin(); it != failed.end(); ++it) {
+            if (!pending_metrics_.contains(it.key())) {
+                pending_metrics_.insert(it.key(), it.value());
+            }
+        }
+        writing_metrics_.clear();
+        if (!pending_metrics_.isEmpty() && !metrics_timer_.isActive()) {
+            metrics_timer_.start();
+        }
+    });
+    scheduler_->add(writer, false);
+}
+
+const AnalyzedPicture* PicModel::unwrittenMetrics(int id) const
+{
+    auto it = pending_metrics_.find(id);
+    if (it != pending_metrics_.end()) {
+        return &it.value();
+    }
+    it = writing_metrics_.find(id);
+    return it != writing_metrics_.end() ? &it.value() : nullptr;
+}
+
+void PicModel::notifyThumbnails()
+{
+    if (first_loaded_row_ < 0) {
+        return;
+    }
+    int last = std::min(last_loaded_row_, rowCount() - 1);
+    if (first_loaded_row_ <= last) {
+        dataChanged(
+            index(first_loaded_row_, kColPath),
+            index(last, kColPath),
+            {Qt::DecorationRole});
+    }
+    first_loaded_row_ = -1;
+    last_loaded_row_ = -1;
+}
+
+int PicModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows_.size();
+}
+
+int PicModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : kNrColumns;
+}
+
+QVariant PicModel::headerData(
+    int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case kColId:
+        return "ID";
+    case kColPath:
+        return "Path";
+    case kColRating:
+        return "Rating";
+    case kColRotation:
+        return "Rotation";
+    case kColSharpness:
+        return "Sharpness";
+    case kColClipped:
+        return "Clipped";
+    default:
+        return QVariant();
+    }
+}
+
+Qt::ItemFlags PicModel::flags(const QModelIndex& index) const
+{
+    Qt::ItemFlags flags = QAbstractTableModel::flags(index);
+    if (index.column() == kColRating || index.column() == kColRotation) {
+        flags |= Qt::ItemIsEditable;
+    }
+    return flags;
 }
 
 QVariant PicModel::data(const QModelIndex& index, int role) const
 {
+    if (!index.isValid() || index.row() >= rows_.size()) {
+        return QVariant();
+    }
+    int row = index.row();
+
     if (index.column() == kColRating && role == Qt::TextAlignmentRole) {
         return Qt::AlignCenter;
     }
     else if (role == Qt::BackgroundRole) {
         QColor color = Qt::white;
 
-        if (!QFile{index.sibling(index.row(), kColPath).data().toString()}.exists()) {
+        if (!QFile{rows_.path(row)}.exists()) {
             color = QColor{255, 240, 240};
         }
 
         return QBrush(color);
     }
     else if (index.column() == kColPath && role == Qt::DecorationRole) {
-        QString path = data(index.sibling(index.row(), kColPath)).toString();
-        auto it = thumbnails_.find(path);
-        if (it != thumbnails_.end()) {
-            return *it;
+        int id = rows_.id(row);
+        if (QPixmap* thumbnail = thumbnails_.object(id)) {
+            return *thumbnail;
         }
-        else if (!loading_indices_.contains(path)) {
-            loading_indices_[path] = index;
-            loader_.load(path, QSize(kThumbnailSize, kThumbnailSize));
-            return QPixmap();
+
+        int rotation = rows_.rotation(row);
+        auto it = pending_thumbnails_.find(id);
+        if (it == pending_thumbnails_.end() || it->rotation != rotation) {
+            pending_thumbnails_.insert(id, {row, rotation});
+            loader_.load(
+                rows_.path(row),
+                QSize(thumbnail_size_, thumbnail_size_),
+                rotation,
+                id);
         }
         else {
-            // thumbnail is loading
-            return QPixmap();
+            // thumbnail is loading, the row may have changed since requested
+            it->row = row;
         }
+        return QPixmap();
     }
-    else {
-        return QSqlTableModel::data(index, role);
+    else if (role == Qt::DisplayRole || role == Qt::EditRole) {
+        switch (index.column()) {
+        case kColId:
+            return rows_.id(row);
+        case kColPath:
+            return rows_.path(row);
+        case kColRating:
+            return rows_.rating(row);
+        case kColRotation:
+            return rows_.rotation(row);
+        case kColSharpness:
+            if (rows_.hasMetrics(row)) {
+                return qRound(rows_.sharpness(row));
+            }
+            break;
+        case kColClipped:
+            if (rows_.hasMetrics(row)) {
+                return QString("%1 %").arg(rows_.clipped(row));
+            }
+            break;
+        }
     }
+    return QVariant();
 }
 
-void PicModel::queryChange()
+bool PicModel::setData(
+    const QModelIndex& index, const QVariant& value, int role)
 {
-    while (canFetchMore()) {
-        fetchMore();
+    if (!index.isValid() || index.row() >= rows_.size()
+        || role != Qt::EditRole
+        || !(flags(index) & Qt::ItemIsEditable)) {
+        return false;
+    }
+    if (!scheduler_) {
+        return false;
+    }
+    // the view is read only, the picture is updated in its own library by
+    // a job: the libraries may be locked for a while
+    int row = index.row();
+    if (index.column() == kColRating) {
+        rate({{row, row}}, value.toInt());
+    }
+    else {
+        rotate({{row, row}}, value.toInt() - rows_.rotation(row));
     }
+    return true;
 }
 
 } // picpic
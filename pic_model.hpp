@@ -1,38 +1,152 @@
 #pragma once
 
+#include <QAbstractTableModel>
+#include <QCache>
 #include <QDebug>
+#include <QHash>
+#include <QPair>
+#include <QPixmap>
+#include <QPointer>
+#include <QSet>
+#include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
-#include <QSqlTableModel>
 #include <QStringList>
+#include <QTimer>
 
+#include "analyzer.hpp"
+#include "database.hpp"
 #include "image_loader.hpp"
+#include "jobs.hpp"
+#include "metrics.hpp"
+#include "row_store.hpp"
+#include "selection.hpp"
 
 namespace picpic {
 
-QSqlDatabase openPicDatabase(const QString& path);
-
-class PicModel : public QSqlTableModel {
+// Pictures of a library, all loaded at once in a RowStore. Ratings and
+// rotations are shown as soon as they are set, and written to the library
+// by jobs of the scheduler, never on the thread of the model. The
+// metrics of the pictures are computed along with their thumbnails when
+// they are missing, and written in batches by jobs of the scheduler.
+class PicModel : public QAbstractTableModel {
     Q_OBJECT
+signals:
+    // ratings or rotations could not be written, the rows were selected
+    // again to show what the libraries hold
+    void writeFailed(const QString& error);
+
 public:
     enum Columns {
         kColId = 0,
         kColPath,
         kColRating,
+        kColRotation,
+        kColSharpness,
+        kColClipped,
+        kNrColumns,
     };
 
-    PicModel(QSqlDatabase db, QObject* parent);
+    // table is kPicturesTable, or kAllPicturesView to browse the attached
+    // libraries too. scheduler runs the writes of the model.
+    PicModel(
+        QSqlDatabase db,
+        const QString& table,
+        JobScheduler* scheduler,
+        QObject* parent);
+    // the pending metrics are written, unless the scheduler is gone: they
+    // are computed again the next time their thumbnails are shown
+    ~PicModel() override;
 
-    bool insert(const QString& path, int rating = 0);
-    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QSqlDatabase database() const { return db_; }
+    const QString& tableName() const { return table_; }
+    // Load the rows again, the model is reset
+    bool select();
+    // SQL condition on the columns, the rows are loaded again if they were
+    void setFilter(const QString& filter);
+    QSqlError lastError() const { return last_error_; }
+
+    // Pictures of the rows, sorted and disjoint [first, last] ranges. When
+    // they are all selected it is the filter of the model, which bulk
+    // operations run in SQL instead of listing the pictures: it is bound
+    // to the ids of the rows, the ones added to the libraries since the
+    // last select() are left out.
+    Selection selection(const QVector<QPair<int, int>>& rows) const;
+    // Rows of the pictures, in order
+    QVector<int> rowsOfIds(const QSet<int>& ids) const;
+    // Rate the pictures of the rows, or rotate them by clockwise quarter
+    // turns: they are shown at once and written in the background
+    void rate(const QVector<QPair<int, int>>& rows, int rating);
+    void rotate(const QVector<QPair<int, int>>& rows, int turns);
+
+    int thumbnailSize() const { return thumbnail_size_; }
+    void setThumbnailSize(int size);
+    // Called by the views after painting: prefetch the thumbnails around
+    // the visible rows and cancel the requests of rows that scrolled away
+    void setVisibleRows(int first, int last);
 
-protected:
-    void queryChange() override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant headerData(
+        int section,
+        Qt::Orientation orientation,
+        int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(
+        const QModelIndex& index,
+        const QVariant& value,
+        int role = Qt::EditRole) override;
+    // Sorted by SQLite, the rows are loaded again if they were
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
 private:
+    struct PendingThumbnail {
+        int row;
+        int rotation;
+    };
+
+    void prefetchThumbnails(int first, int last);
+    void onThumbnailLoaded(const QPixmap& pixmap, int rotation, int id);
+    void onMetricsComputed(const PictureMetrics& metrics, int id);
+    void writeMetrics();
+    // metrics computed by the model but not written yet, or nullptr
+    const AnalyzedPicture* unwrittenMetrics(int id) const;
+    void notifyThumbnails();
+    // job is a Rater or a Rotator, its failure is reported by writeFailed
+    template <typename T>
+    void write(T* job);
+
+    QSqlDatabase db_;
+    const QString table_;
+    QPointer<JobScheduler> scheduler_;
+    QString filter_;
+    int sort_column_{-1};
+    Qt::SortOrder sort_order_{Qt::AscendingOrder};
+    bool selected_{false};
+    // ratings set since the rows were selected may not match the filter
+    bool rows_match_filter_{false};
+    QSqlError last_error_;
+    RowStore rows_;
+    // largest id of the rows in each library, by libraryIndex for the view
+    QVector<int> max_ids_;
+
     mutable ImageLoader loader_;
-    QMap<QString, QPixmap> thumbnails_;
-    mutable QMap<QString, QModelIndex> loading_indices_;
+    int thumbnail_size_{32};
+    // keyed by picture id: rows change every time the model is selected
+    QCache<int, QPixmap> thumbnails_;
+    mutable QHash<int, PendingThumbnail> pending_thumbnails_;
+    // loaded thumbnails are notified at most once per frame
+    QTimer notify_timer_;
+    int first_loaded_row_{-1};
+    int last_loaded_row_{-1};
+    // keyed by picture id, written at most once per interval by a single
+    // MetricsWriter at a time
+    QHash<int, AnalyzedPicture> pending_metrics_;
+    // given to the MetricsWriter running, shown if the rows are selected
+    // again before they are written
+    QHash<int, AnalyzedPicture> writing_metrics_;
+    QTimer metrics_timer_;
 };
 
 } // picpic
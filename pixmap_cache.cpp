@@ -0,0 +1,49 @@
+#include "pixmap_cache.hpp"
+
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+bool covers(const QPixmap& pixmap, QSize bound)
+{
+    QSize needed = pixmap.size().scaled(bound, Qt::KeepAspectRatio);
+    return needed.width() <= pixmap.width()
+           && needed.height() <= pixmap.height();
+}
+
+} // <anonymous>
+
+PixmapCache::PixmapCache(int max_pictures) : cache_(max_pictures) {}
+
+const QPixmap* PixmapCache::find(
+    const QString& path, int rotation, QSize bound, bool* full) const
+{
+    Entry* entry = cache_[path];
+    if (!entry || entry->rotation != rotation
+        || (!entry->full
+            && (!bound.isValid() || !covers(entry->pixmap, bound)))) {
+        addToCounter(Counter::kPixmapCacheMisses);
+        return nullptr;
+    }
+    addToCounter(Counter::kPixmapCacheHits);
+    if (full) {
+        *full = entry->full;
+    }
+    return &entry->pixmap;
+}
+
+void PixmapCache::insert(
+    const QString& path, int rotation, const QPixmap& pixmap, bool full)
+{
+    Entry* previous = cache_.object(path);
+    if (previous && previous->rotation == rotation && !full
+        && (previous->full || covers(previous->pixmap, pixmap.size()))) {
+        // keep the best decoded version
+        return;
+    }
+    cache_.insert(path, new Entry{pixmap, rotation, full});
+}
+
+} // picpic
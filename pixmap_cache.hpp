@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QCache>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+
+namespace picpic {
+
+// Decoded pictures shared between all the viewers. An entry may have been
+// decoded at a reduced size, in which case it is only returned to viewers
+// that do not need more pixels than it holds. Entries decoded with another
+// rotation are never returned.
+class PixmapCache {
+public:
+    PixmapCache(int max_pictures);
+
+    const QPixmap* find(
+        const QString& path,
+        int rotation,
+        QSize bound = {},
+        bool* full = nullptr) const;
+    void insert(
+        const QString& path, int rotation, const QPixmap& pixmap, bool full);
+
+private:
+    struct Entry {
+        QPixmap pixmap;
+        int rotation;
+        bool full;
+    };
+
+    QCache<QString, Entry> cache_;
+};
+
+} // picpic
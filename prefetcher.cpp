@@ -0,0 +1,142 @@
+#include "prefetcher.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+#include <QFile>
+
+#include "trace.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace picpic {
+
+namespace {
+
+constexpr int kNrThreads = 4;
+// files sorted together, more gives a better order but a later start
+constexpr size_t kBatchSize = 32;
+constexpr qint64 kReadChunkSize = 1 << 20;
+
+struct Entry {
+    QString path;
+    quint64 device{0};
+    quint64 inode{0};
+};
+
+Entry entry(const QString& path)
+{
+    Entry result{path};
+#ifndef _WIN32
+    struct stat info;
+    if (stat(QFile::encodeName(path).constData(), &info) == 0) {
+        result.device = info.st_dev;
+        result.inode = info.st_ino;
+    }
+#endif
+    return result;
+}
+
+} // <anonymous>
+
+Prefetcher::Prefetcher(
+    std::function<bool(const QString& path)> wanted, int size)
+    : wanted_{std::move(wanted)}, size_{size}
+{
+    for (int i = 0; i < kNrThreads; ++i) {
+        threads_.emplace_back([this] { run(); });
+    }
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+        cv_.notify_all();
+    }
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void Prefetcher::prefetch(const QStringList& paths)
+{
+    if (paths.isEmpty()) {
+        return;
+    }
+    std::lock_guard lock{mutex_};
+    pending_.insert(pending_.end(), paths.begin(), paths.end());
+    if (size_ > 0 && pending_.size() > size_t(size_)) {
+        pending_.erase(pending_.begin(), pending_.end() - size_);
+    }
+    cv_.notify_all();
+}
+
+void Prefetcher::clear()
+{
+    std::lock_guard lock{mutex_};
+    pending_.clear();
+}
+
+void Prefetcher::run()
+{
+    while (true) {
+        std::vector<Entry> batch;
+        {
+            std::unique_lock lock{mutex_};
+            cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            if (stop_) {
+                return;
+            }
+            while (!pending_.empty() && batch.size() < kBatchSize) {
+                batch.push_back(Entry{pending_.front()});
+                pending_.pop_front();
+            }
+        }
+
+        TraceScope trace{"Prefetcher::batch"};
+        for (auto& file : batch) {
+            file = entry(file.path);
+        }
+        std::sort(batch.begin(), batch.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.device, a.inode) < std::tie(b.device, b.inode);
+        });
+        for (const auto& file : batch) {
+            if (!wanted_ || wanted_(file.path)) {
+                qint64 size = prefetchFile(file.path);
+                addToCounter(Counter::kPrefetchedBytes, size);
+            }
+        }
+    }
+}
+
+qint64 Prefetcher::prefetchFile(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+#ifdef __linux__
+    // the kernel reads the file asynchronously, many reads are in flight
+    if (posix_fadvise(file.handle(), 0, 0, POSIX_FADV_WILLNEED) == 0) {
+        return file.size();
+    }
+#endif
+    // elsewhere the file is read through and the data thrown away, it
+    // stays in the page cache
+    qint64 size = 0;
+    while (!file.atEnd()) {
+        QByteArray chunk = file.read(kReadChunkSize);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        size += chunk.size();
+    }
+    return size;
+}
+
+} // picpic
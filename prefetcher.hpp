@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+namespace picpic {
+
+// Reads files into the page cache ahead of their decode, so that the
+// decoding thread does not wait for the disk. Files are taken in batches
+// and read in inode order, which follows their layout on most local file
+// systems, by several threads so that many reads are in flight at once.
+class Prefetcher {
+public:
+    // wanted is called on the prefetching threads, files for which it
+    // returns false are not read. At most size files are queued, the
+    // oldest ones are dropped, when it is positive.
+    explicit Prefetcher(
+        std::function<bool(const QString& path)> wanted = {}, int size = -1);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // Queue the files and return at once
+    void prefetch(const QStringList& paths);
+    // Forget the queued files, the ones being read are read anyway
+    void clear();
+
+private:
+    void run();
+    // Hint the kernel or read the file, return the number of bytes read
+    qint64 prefetchFile(const QString& path);
+
+    std::function<bool(const QString& path)> wanted_;
+    const int size_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<QString> pending_;
+    bool stop_{false};
+    std::vector<std::thread> threads_;
+};
+
+} // picpic
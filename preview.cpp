@@ -0,0 +1,317 @@
+#include "preview.hpp"
+
+#include <algorithm>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QSet>
+#include <QTransform>
+#include <QVector>
+
+namespace picpic {
+
+namespace {
+
+// the EXIF segment is at most 64 KiB and comes first
+constexpr qint64 kExifReadSize = 128 * 1024;
+// corrupt files may chain IFDs in loops
+constexpr int kMaxIfds = 64;
+// values read of an entry, corrupt files may claim billions of them: only
+// a few sub IFDs are followed, and single strip previews are kept
+constexpr qint64 kMaxValues = kMaxIfds;
+
+constexpr quint16 kTagCompression = 0x0103;
+constexpr quint16 kTagStripOffsets = 0x0111;
+constexpr quint16 kTagOrientation = 0x0112;
+constexpr quint16 kTagStripByteCounts = 0x0117;
+constexpr quint16 kTagSubIfds = 0x014a;
+constexpr quint16 kTagJpegOffset = 0x0201;
+constexpr quint16 kTagJpegLength = 0x0202;
+
+constexpr quint16 kTypeShort = 3;
+constexpr quint16 kTypeLong = 4;
+constexpr quint16 kTypeIfd = 13;
+// old style and new style JPEG compression
+constexpr quint32 kCompressionJpeg = 6;
+constexpr quint32 kCompressionNewJpeg = 7;
+
+// TIFF structure, as found in EXIF segments and RAW files: a header then
+// chained IFDs of 12 bytes entries. Out of range reads return 0.
+class TiffReader {
+public:
+    TiffReader(const uchar* data, qint64 size) : data_{data}, size_{size}
+    {
+        little_endian_ = size_ >= 2 && data_[0] == 'I';
+    }
+
+    bool isValid() const
+    {
+        if (size_ < 8) {
+            return false;
+        }
+        return (little_endian_ && data_[1] == 'I' && u16(2) == 42)
+               || (data_[0] == 'M' && data_[1] == 'M' && u16(2) == 42);
+    }
+
+    quint16 u16(qint64 offset) const
+    {
+        if (offset < 0 || offset + 2 > size_) {
+            return 0;
+        }
+        const uchar* b = data_ + offset;
+        return little_endian_ ? b[0] | b[1] << 8 : b[0] << 8 | b[1];
+    }
+
+    quint32 u32(qint64 offset) const
+    {
+        quint32 a = u16(offset);
+        quint32 b = u16(offset + 2);
+        return little_endian_ ? a | b << 16 : a << 16 | b;
+    }
+
+    quint32 firstIfd() const { return u32(4); }
+    quint32 nextIfd(quint32 ifd) const
+    {
+        return u32(qint64(ifd) + 2 + 12 * u16(ifd));
+    }
+
+    // Values of a SHORT or LONG entry of the IFD, empty if it is missing,
+    // at most max_values of them
+    QVector<quint32> values(
+        quint32 ifd, quint16 tag, qint64 max_values = kMaxValues) const
+    {
+        int count = u16(ifd);
+        for (int i = 0; i < count; ++i) {
+            qint64 offset = qint64(ifd) + 2 + 12 * i;
+            if (u16(offset) != tag) {
+                continue;
+            }
+
+            quint16 type = u16(offset + 2);
+            if (type != kTypeShort && type != kTypeLong && type != kTypeIfd) {
+                return {};
+            }
+            int type_size = type == kTypeShort ? 2 : 4;
+            qint64 nr_values = u32(offset + 4);
+            // values fitting in 4 bytes are stored in the entry itself
+            qint64 at = nr_values * type_size <= 4 ? offset + 8
+                                                   : u32(offset + 8);
+            nr_values = std::min(
+                {nr_values, (size_ - at) / type_size, max_values});
+
+            QVector<quint32> result;
+            for (qint64 j = 0; j < nr_values; ++j) {
+                result.push_back(
+                    type_size == 2 ? u16(at + 2 * j) : u32(at + 4 * j));
+            }
+            return result;
+        }
+        return {};
+    }
+
+    quint32 value(quint32 ifd, quint16 tag) const
+    {
+        return values(ifd, tag, 1).value(0);
+    }
+
+    bool contains(qint64 offset, qint64 length) const
+    {
+        return offset > 0 && length > 0 && offset + length <= size_;
+    }
+
+private:
+    const uchar* data_;
+    qint64 size_;
+    bool little_endian_;
+};
+
+// Payload of the APP1 Exif segment of a JPEG file
+QByteArray exifSegment(const QByteArray& jpeg)
+{
+    static const QByteArray kExifHeader("Exif\0\0", 6);
+    const auto* bytes = reinterpret_cast<const uchar*>(jpeg.constData());
+    if (jpeg.size() < 4 || bytes[0] != 0xff || bytes[1] != 0xd8) {
+        return {};
+    }
+
+    qint64 pos = 2;
+    while (pos + 4 <= jpeg.size() && bytes[pos] == 0xff) {
+        uchar marker = bytes[pos + 1];
+        if (marker == 0xda) {
+            // start of scan, metadata come before it
+            break;
+        }
+        qint64 length = bytes[pos + 2] << 8 | bytes[pos + 3];
+        QByteArray payload = jpeg.mid(pos + 4, length - 2);
+        if (marker == 0xe1 && payload.startsWith(kExifHeader)) {
+            return payload.mid(kExifHeader.size());
+        }
+        pos += 2 + length;
+    }
+    return {};
+}
+
+// Size of a baseline or progressive JPEG. It is invalid for anything else,
+// like the lossless JPEG holding the raw data of most RAW files.
+QSize jpegSize(const uchar* data, qint64 size)
+{
+    if (size < 4 || data[0] != 0xff || data[1] != 0xd8) {
+        return {};
+    }
+
+    qint64 pos = 2;
+    while (pos + 9 <= size && data[pos] == 0xff) {
+        uchar marker = data[pos + 1];
+        if (marker == 0xff) {
+            // fill byte
+            ++pos;
+            continue;
+        }
+        if (marker == 0xc0 || marker == 0xc1 || marker == 0xc2) {
+            return QSize(
+                data[pos + 7] << 8 | data[pos + 8],
+                data[pos + 5] << 8 | data[pos + 6]);
+        }
+        if ((marker > 0xc2 && marker <= 0xcf && marker != 0xc4
+             && marker != 0xc8 && marker != 0xcc)
+            || marker == 0xda) {
+            // other frame types, or a scan without frame
+            return {};
+        }
+        pos += 2 + (data[pos + 2] << 8 | data[pos + 3]);
+    }
+    return {};
+}
+
+} // <anonymous>
+
+QImage loadEmbeddedPreview(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QByteArray exif = exifSegment(file.read(kExifReadSize));
+    const auto* data = reinterpret_cast<const uchar*>(exif.constData());
+    TiffReader tiff{data, exif.size()};
+    if (!tiff.isValid()) {
+        return {};
+    }
+
+    // the thumbnail is described by IFD1, the orientation by IFD0
+    quint32 ifd0 = tiff.firstIfd();
+    quint32 ifd1 = tiff.nextIfd(ifd0);
+    if (ifd1 == 0) {
+        return {};
+    }
+    qint64 offset = tiff.value(ifd1, kTagJpegOffset);
+    qint64 length = tiff.value(ifd1, kTagJpegLength);
+    if (!tiff.contains(offset, length)) {
+        return {};
+    }
+
+    QImage preview = QImage::fromData(data + offset, length, "JPEG");
+    return applyOrientation(preview, tiff.value(ifd0, kTagOrientation));
+}
+
+QImage applyOrientation(const QImage& image, int orientation)
+{
+    switch (orientation) {
+    case 2:
+        return image.mirrored(true, false);
+    case 3:
+        return image.transformed(QTransform().rotate(180));
+    case 4:
+        return image.mirrored(false, true);
+    case 5:
+        return image.transformed(QTransform().rotate(90))
+            .mirrored(true, false);
+    case 6:
+        return image.transformed(QTransform().rotate(90));
+    case 7:
+        return image.transformed(QTransform().rotate(270))
+            .mirrored(true, false);
+    case 8:
+        return image.transformed(QTransform().rotate(270));
+    default:
+        return image;
+    }
+}
+
+bool isTransposed(int orientation)
+{
+    return orientation >= 5 && orientation <= 8;
+}
+
+bool isRawFile(const QString& path)
+{
+    static const QSet<QString> suffixes{"cr2", "nef", "arw", "dng"};
+    return suffixes.contains(QFileInfo(path).suffix().toLower());
+}
+
+RawPreview::RawPreview(const MappedFile& file) : data_{file.data()}
+{
+    if (!data_) {
+        return;
+    }
+
+    TiffReader tiff{data_, file.size()};
+    if (!tiff.isValid()) {
+        return;
+    }
+    quint32 orientation = tiff.value(tiff.firstIfd(), kTagOrientation);
+    orientation_ = orientation > 0 ? orientation : 1;
+
+    // Previews are either referenced like EXIF thumbnails or stored as a
+    // single JPEG strip, in the IFD chain or in sub IFDs. Keep the largest.
+    QVector<quint32> ifds{tiff.firstIfd()};
+    QSet<quint32> visited;
+    while (!ifds.isEmpty() && visited.size() < kMaxIfds) {
+        quint32 ifd = ifds.takeLast();
+        if (ifd == 0 || visited.contains(ifd)) {
+            continue;
+        }
+        visited.insert(ifd);
+        ifds.push_back(tiff.nextIfd(ifd));
+        ifds += tiff.values(ifd, kTagSubIfds);
+
+        QVector<QPair<qint64, qint64>> candidates{
+            {tiff.value(ifd, kTagJpegOffset), tiff.value(ifd, kTagJpegLength)},
+        };
+        quint32 compression = tiff.value(ifd, kTagCompression);
+        QVector<quint32> strips = tiff.values(ifd, kTagStripOffsets);
+        if ((compression == kCompressionJpeg
+             || compression == kCompressionNewJpeg)
+            && strips.size() == 1) {
+            candidates.push_back(
+                {strips[0], tiff.value(ifd, kTagStripByteCounts)});
+        }
+
+        for (const auto& candidate : candidates) {
+            if (!tiff.contains(candidate.first, candidate.second)) {
+                continue;
+            }
+            QSize size = jpegSize(data_ + candidate.first, candidate.second);
+            if (size.isValid()
+                && qint64(size.width()) * size.height()
+                       > qint64(size_.width()) * size_.height()) {
+                offset_ = candidate.first;
+                length_ = candidate.second;
+                size_ = size;
+            }
+        }
+    }
+}
+
+QByteArray RawPreview::jpeg() const
+{
+    if (!isValid()) {
+        return {};
+    }
+    return QByteArray::fromRawData(
+        reinterpret_cast<const char*>(data_ + offset_), length_);
+}
+
+} // picpic
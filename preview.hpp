@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+#include "mapped_file.hpp"
+
+namespace picpic {
+
+// Return the preview embedded in the EXIF data of the picture at path,
+// oriented for display, or a null image if there is none. It is much
+// faster to get than any decode of the picture itself.
+QImage loadEmbeddedPreview(const QString& path);
+
+// Transform a picture stored with an EXIF orientation for display
+QImage applyOrientation(const QImage& image, int orientation);
+// true for the EXIF orientations rotating the picture by a quarter turn
+bool isTransposed(int orientation);
+
+// Camera RAW files are displayed through the JPEG preview they embed
+bool isRawFile(const QString& path);
+
+// Largest JPEG preview embedded in a TIFF based RAW file: CR2, NEF, ARW or
+// DNG. It is found in the memory mapped file and it is not copied, the raw
+// data itself is never decoded.
+class RawPreview {
+public:
+    explicit RawPreview(const MappedFile& file);
+
+    bool isValid() const { return length_ > 0; }
+    // JPEG data of the preview, only valid as long as the mapping
+    QByteArray jpeg() const;
+    // Size of the preview as stored, before the orientation is applied
+    QSize size() const { return size_; }
+    int orientation() const { return orientation_; }
+
+private:
+    const uchar* data_{nullptr};
+    qint64 offset_{0};
+    qint64 length_{0};
+    QSize size_;
+    int orientation_{1};
+};
+
+} // picpic
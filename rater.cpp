@@ -0,0 +1,51 @@
+#include "rater.hpp"
+
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "database.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+Rater::Rater(QSqlDatabase db, const Selection& selection, int rating)
+    : Job(selection.size() < 0 ? QString("Rate pictures %1").arg(rating)
+                                : QString("Rate %1 pictures %2")
+                                      .arg(selection.size())
+                                      .arg(rating),
+          Resource::kDatabase),
+      cursor_{db, selection},
+      rating_{rating},
+      size_{selection.size()}
+{
+}
+
+Rater::Step Rater::step()
+{
+    progress(nr_rated_, size_);
+
+    QString library;
+    QVector<int> ids;
+    QStringList paths;
+    if (!cursor_.next(&library, &ids, &paths)) {
+        if (!cursor_.errorString().isEmpty()) {
+            error_ = cursor_.errorString();
+            return Step::kFailed;
+        }
+        return success_ ? Step::kDone : Step::kFailed;
+    }
+
+    TraceScope trace{"Rater::step"};
+    QSqlQuery query(openWorkerDatabase(library));
+    if (!query.exec(QString("UPDATE %1 SET rating = %2 WHERE id IN (%3)")
+                        .arg(kPicturesTable)
+                        .arg(rating_)
+                        .arg(joinIds(ids)))) {
+        success_ = false;
+        error_ = query.lastError().text();
+    }
+    nr_rated_ += ids.size();
+    return Step::kContinue;
+}
+
+} // picpic
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QSqlDatabase>
+
+#include "jobs.hpp"
+#include "selection.hpp"
+
+namespace picpic {
+
+// Sets the rating of pictures in their library, on the database thread of
+// the scheduler with its own connection
+class Rater : public Job {
+    Q_OBJECT
+public:
+    Rater(QSqlDatabase db, const Selection& selection, int rating);
+    const QString& errorString() const { return error_; }
+
+protected:
+    Step step() override;
+
+private:
+    SelectionCursor cursor_;
+    const int rating_;
+    const int size_;
+    int nr_rated_{0};
+    QString error_;
+    bool success_{true};
+};
+
+} // picpic
@@ -0,0 +1,689 @@
+#include "resample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) \
+    || defined(_M_IX86)
+#define PICPIC_RESAMPLE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PICPIC_RESAMPLE_NEON
+#include <arm_neon.h>
+#endif
+
+// instructions sets are enabled per function, the rest of the program does
+// not require them
+#if defined(PICPIC_RESAMPLE_X86) && defined(__GNUC__)
+#define PICPIC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PICPIC_TARGET(isa)
+#endif
+
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+// fixed point precision of the Lanczos weights
+constexpr int kWeightBits = 14;
+constexpr int kLanczosRadius = 3;
+// block averaging accumulates 8 bits samples into 16 bits
+constexpr int kMaxBoxFactor = 256;
+// images with more source pixels are processed on several threads
+constexpr qint64 kParallelPixels = 8 * 1000 * 1000;
+constexpr int kMaxBands = 8;
+constexpr double kPi = 3.14159265358979323846;
+
+// Row kernels over 8 bits samples, with one version per instruction set.
+//
+// accumulate: acc[i] += src[i]
+// filter: dst[i] = sum of rows[t][i] * weights[t], weights in fixed point
+// convolve: pixel x of dst = sum of the pixels first[x] + t of src times
+// weights[x * taps + t], over the 4 samples of the pixels
+struct Kernels {
+    void (*accumulate)(const uchar* src, quint16* acc, int n);
+    void (*filter)(
+        const uchar* const* rows,
+        const qint16* weights,
+        int taps,
+        uchar* dst,
+        int n);
+    void (*convolve)(
+        const uchar* src,
+        const int* first,
+        const qint16* weights,
+        int taps,
+        uchar* dst,
+        int width);
+    const char* name;
+};
+
+void accumulateScalar(const uchar* src, quint16* acc, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        acc[i] += src[i];
+    }
+}
+
+void filterScalar(
+    const uchar* const* rows,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int n)
+{
+    for (int i = 0; i < n; ++i) {
+        int sum = 1 << (kWeightBits - 1);
+        for (int t = 0; t < taps; ++t) {
+            sum += rows[t][i] * weights[t];
+        }
+        dst[i] = std::clamp(sum >> kWeightBits, 0, 255);
+    }
+}
+
+void convolveScalar(
+    const uchar* src,
+    const int* first,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int width)
+{
+    for (int x = 0; x < width; ++x, weights += taps) {
+        const uchar* pixel = src + first[x] * 4;
+        int sum[4] = {
+            1 << (kWeightBits - 1),
+            1 << (kWeightBits - 1),
+            1 << (kWeightBits - 1),
+            1 << (kWeightBits - 1)};
+        for (int t = 0; t < taps; ++t, pixel += 4) {
+            sum[0] += pixel[0] * weights[t];
+            sum[1] += pixel[1] * weights[t];
+            sum[2] += pixel[2] * weights[t];
+            sum[3] += pixel[3] * weights[t];
+        }
+        for (int c = 0; c < 4; ++c) {
+            dst[x * 4 + c] = uchar(std::clamp(sum[c] >> kWeightBits, 0, 255));
+        }
+    }
+}
+
+// Remaining samples of the vectorized kernels
+void filterTail(
+    const uchar* const* rows,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int begin,
+    int n)
+{
+    std::vector<const uchar*> tail(rows, rows + taps);
+    for (auto& row : tail) {
+        row += begin;
+    }
+    filterScalar(tail.data(), weights, taps, dst + begin, n - begin);
+}
+
+#if defined(PICPIC_RESAMPLE_X86)
+
+PICPIC_TARGET("sse4.1")
+void accumulateSse41(const uchar* src, quint16* acc, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_cvtepu8_epi16(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+        __m128i* a = reinterpret_cast<__m128i*>(acc + i);
+        _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), s));
+    }
+    accumulateScalar(src + i, acc + i, n - i);
+}
+
+// Taps are taken by pairs: samples of two rows are interleaved and
+// multiplied by their weights and added by a single madd.
+PICPIC_TARGET("sse4.1")
+void filterSse41(
+    const uchar* const* rows,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int n)
+{
+    const __m128i round = _mm_set1_epi32(1 << (kWeightBits - 1));
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = round;
+        __m128i hi = round;
+        for (int t = 0; t < taps; t += 2) {
+            __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(
+                reinterpret_cast<const __m128i*>(rows[t] + i)));
+            __m128i b = t + 1 < taps
+                            ? _mm_cvtepu8_epi16(_mm_loadl_epi64(
+                                reinterpret_cast<const __m128i*>(
+                                    rows[t + 1] + i)))
+                            : zero;
+            qint16 wb = t + 1 < taps ? weights[t + 1] : 0;
+            __m128i w = _mm_set1_epi32(
+                quint16(weights[t]) | quint32(quint16(wb)) << 16);
+            lo = _mm_add_epi32(
+                lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(
+                hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        lo = _mm_srai_epi32(lo, kWeightBits);
+        hi = _mm_srai_epi32(hi, kWeightBits);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(lo, hi), zero);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    filterTail(rows, weights, taps, dst, i, n);
+}
+
+// Taps are taken by pairs too: a shuffle interleaves the samples of two
+// neighbour pixels by channel, and a madd gives the 4 sums of the pair.
+// Wider registers would hold the taps of several destination pixels, whose
+// weights differ, so AVX2 CPUs use this kernel as well.
+PICPIC_TARGET("sse4.1")
+void convolveSse41(
+    const uchar* src,
+    const int* first,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int width)
+{
+    const __m128i round = _mm_set1_epi32(1 << (kWeightBits - 1));
+    const __m128i interleave = _mm_setr_epi8(
+        0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+    for (int x = 0; x < width; ++x, weights += taps) {
+        const uchar* pixel = src + first[x] * 4;
+        __m128i sum = round;
+        int t = 0;
+        for (; t + 2 <= taps; t += 2, pixel += 8) {
+            __m128i pair = _mm_shuffle_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel)),
+                interleave);
+            __m128i w = _mm_set1_epi32(
+                quint16(weights[t]) | quint32(quint16(weights[t + 1])) << 16);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, w));
+        }
+        if (t < taps) {
+            // the last pixel of the row may be the last of the image, it is
+            // loaded alone
+            qint32 last;
+            std::memcpy(&last, pixel, sizeof(last));
+            __m128i samples = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(last));
+            sum = _mm_add_epi32(
+                sum, _mm_mullo_epi32(samples, _mm_set1_epi32(weights[t])));
+        }
+        sum = _mm_srai_epi32(sum, kWeightBits);
+        __m128i packed = _mm_packs_epi32(sum, sum);
+        qint32 out = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+        std::memcpy(dst + x * 4, &out, sizeof(out));
+    }
+}
+
+PICPIC_TARGET("avx2")
+void accumulateAvx2(const uchar* src, quint16* acc, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i s = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        __m256i* a = reinterpret_cast<__m256i*>(acc + i);
+        _mm256_storeu_si256(a, _mm256_add_epi16(_mm256_loadu_si256(a), s));
+    }
+    accumulateScalar(src + i, acc + i, n - i);
+}
+
+PICPIC_TARGET("avx2")
+void filterAvx2(
+    const uchar* const* rows,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int n)
+{
+    const __m256i round = _mm256_set1_epi32(1 << (kWeightBits - 1));
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = round;
+        __m256i hi = round;
+        for (int t = 0; t < taps; t += 2) {
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(rows[t] + i)));
+            __m256i b = t + 1 < taps
+                            ? _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                                reinterpret_cast<const __m128i*>(
+                                    rows[t + 1] + i)))
+                            : zero;
+            qint16 wb = t + 1 < taps ? weights[t + 1] : 0;
+            __m256i w = _mm256_set1_epi32(
+                quint16(weights[t]) | quint32(quint16(wb)) << 16);
+            // unpack works within 128 bits lanes: lo holds samples 0-3 and
+            // 8-11, hi 4-7 and 12-15
+            lo = _mm256_add_epi32(
+                lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            hi = _mm256_add_epi32(
+                hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        lo = _mm256_srai_epi32(lo, kWeightBits);
+        hi = _mm256_srai_epi32(hi, kWeightBits);
+        // packing is per lane too, which puts the samples back in order
+        __m256i packed =
+            _mm256_packus_epi16(_mm256_packs_epi32(lo, hi), zero);
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(dst + i),
+            _mm256_castsi256_si128(packed));
+    }
+    filterTail(rows, weights, taps, dst, i, n);
+}
+
+#endif // PICPIC_RESAMPLE_X86
+
+#if defined(PICPIC_RESAMPLE_NEON)
+
+void accumulateNeon(const uchar* src, quint16* acc, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vld1_u8(src + i)));
+    }
+    accumulateScalar(src + i, acc + i, n - i);
+}
+
+void filterNeon(
+    const uchar* const* rows,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int32x4_t lo = vdupq_n_s32(1 << (kWeightBits - 1));
+        int32x4_t hi = lo;
+        for (int t = 0; t < taps; ++t) {
+            int16x8_t s =
+                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[t] + i)));
+            lo = vmlal_n_s16(lo, vget_low_s16(s), weights[t]);
+            hi = vmlal_n_s16(hi, vget_high_s16(s), weights[t]);
+        }
+        int16x8_t packed = vcombine_s16(
+            vqmovn_s32(vshrq_n_s32(lo, kWeightBits)),
+            vqmovn_s32(vshrq_n_s32(hi, kWeightBits)));
+        vst1_u8(dst + i, vqmovun_s16(packed));
+    }
+    filterTail(rows, weights, taps, dst, i, n);
+}
+
+void convolveNeon(
+    const uchar* src,
+    const int* first,
+    const qint16* weights,
+    int taps,
+    uchar* dst,
+    int width)
+{
+    for (int x = 0; x < width; ++x, weights += taps) {
+        const uchar* pixel = src + first[x] * 4;
+        int32x4_t sum = vdupq_n_s32(1 << (kWeightBits - 1));
+        for (int t = 0; t < taps; ++t, pixel += 4) {
+            quint32 bits;
+            std::memcpy(&bits, pixel, sizeof(bits));
+            int16x4_t samples = vreinterpret_s16_u16(vget_low_u16(
+                vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bits)))));
+            sum = vmlal_n_s16(sum, samples, weights[t]);
+        }
+        int16x4_t narrowed = vqmovn_s32(vshrq_n_s32(sum, kWeightBits));
+        uint8x8_t packed = vqmovun_s16(vcombine_s16(narrowed, narrowed));
+        quint32 out = vget_lane_u32(vreinterpret_u32_u8(packed), 0);
+        std::memcpy(dst + x * 4, &out, sizeof(out));
+    }
+}
+
+#endif // PICPIC_RESAMPLE_NEON
+
+Kernels detectKernels()
+{
+#if defined(PICPIC_RESAMPLE_X86)
+    bool sse41 = false;
+    bool avx2 = false;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int nr_ids = info[0];
+    if (nr_ids >= 1) {
+        __cpuid(info, 1);
+        sse41 = info[2] & (1 << 19);
+        // the OS must save the AVX registers too
+        bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28))
+                      && (_xgetbv(0) & 6) == 6;
+        if (nr_ids >= 7 && os_avx) {
+            __cpuidex(info, 7, 0);
+            avx2 = info[1] & (1 << 5);
+        }
+    }
+#else
+    __builtin_cpu_init();
+    sse41 = __builtin_cpu_supports("sse4.1");
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2) {
+        return {accumulateAvx2, filterAvx2, convolveSse41, "avx2"};
+    }
+    if (sse41) {
+        return {accumulateSse41, filterSse41, convolveSse41, "sse4.1"};
+    }
+#elif defined(PICPIC_RESAMPLE_NEON)
+    return {accumulateNeon, filterNeon, convolveNeon, "neon"};
+#endif
+    return {accumulateScalar, filterScalar, convolveScalar, "scalar"};
+}
+
+const Kernels& kernels()
+{
+    static const Kernels detected = detectKernels();
+    return detected;
+}
+
+class BandRunnable : public QRunnable {
+public:
+    explicit BandRunnable(std::function<void()> function)
+        : function_{std::move(function)}
+    {
+    }
+
+    void run() override { function_(); }
+
+private:
+    std::function<void()> function_;
+};
+
+// Threads of the bands, kept between the calls: a resample takes a few
+// milliseconds, starting threads for each one is a large part of it
+QThreadPool& bandPool()
+{
+    static QThreadPool* pool = [] {
+        auto pool = new QThreadPool;
+        pool->setMaxThreadCount(kMaxBands - 1);
+        pool->setExpiryTimeout(-1);
+        return pool;
+    }();
+    return *pool;
+}
+
+// Call function(begin, end) over bands of [0, nr_rows), on several threads
+// when there are enough pixels to be worth it. The first band runs on the
+// calling thread.
+void forEachBand(
+    int nr_rows, qint64 pixels, const std::function<void(int, int)>& function)
+{
+    int nr_bands = 1;
+    if (pixels >= kParallelPixels) {
+        nr_bands = std::clamp(
+            int(std::thread::hardware_concurrency()), 1, kMaxBands);
+    }
+    nr_bands = std::min(nr_bands, nr_rows);
+    if (nr_bands <= 1) {
+        function(0, nr_rows);
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable done;
+    int remaining = nr_bands - 1;
+    for (int band = 1; band < nr_bands; ++band) {
+        int begin = nr_rows * band / nr_bands;
+        int end = nr_rows * (band + 1) / nr_bands;
+        bandPool().start(new BandRunnable([&, begin, end] {
+            function(begin, end);
+            std::lock_guard lock{mutex};
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        }));
+    }
+    function(0, nr_rows / nr_bands);
+    std::unique_lock lock{mutex};
+    done.wait(lock, [&] { return remaining == 0; });
+}
+
+// Average blocks of fx by fy pixels, the remaining rows and columns are
+// dropped. Pixels are 4 samples of 8 bits.
+QImage boxReduce(const QImage& src, int fx, int fy)
+{
+    TraceScope trace{"resample::boxReduce"};
+
+    const int width = src.width() / fx;
+    const int height = src.height() / fy;
+    QImage dst(width, height, src.format());
+    uchar* dst_bits = dst.bits();
+    const int dst_stride = dst.bytesPerLine();
+    const int src_samples = width * fx * 4;
+    // fixed point reciprocal of the block size
+    const quint64 inverse = (quint64(1) << 32) / (fx * fy);
+    const Kernels& k = kernels();
+
+    const qint64 pixels = qint64(src.width()) * src.height();
+    forEachBand(height, pixels, [&](int begin, int end) {
+        std::vector<quint16> acc(src_samples);
+        for (int y = begin; y < end; ++y) {
+            std::fill(acc.begin(), acc.end(), 0);
+            for (int r = 0; r < fy; ++r) {
+                k.accumulate(
+                    src.constScanLine(y * fy + r), acc.data(), src_samples);
+            }
+
+            uchar* line = dst_bits + qint64(y) * dst_stride;
+            const quint16* block = acc.data();
+            for (int x = 0; x < width * 4; x += 4, block += fx * 4) {
+                quint32 sum[4] = {0, 0, 0, 0};
+                for (int j = 0; j < fx * 4; j += 4) {
+                    sum[0] += block[j];
+                    sum[1] += block[j + 1];
+                    sum[2] += block[j + 2];
+                    sum[3] += block[j + 3];
+                }
+                for (int c = 0; c < 4; ++c) {
+                    line[x + c] = uchar(
+                        (sum[c] * inverse + (quint64(1) << 31)) >> 32);
+                }
+            }
+        }
+    });
+    return dst;
+}
+
+double lanczos(double x)
+{
+    if (x == 0) {
+        return 1;
+    }
+    if (std::abs(x) >= kLanczosRadius) {
+        return 0;
+    }
+    const double pi_x = kPi * x;
+    return kLanczosRadius * std::sin(pi_x) * std::sin(pi_x / kLanczosRadius)
+           / (pi_x * pi_x);
+}
+
+// Source samples contributing to each destination sample along an axis:
+// taps consecutive samples from first[i], with weights[i * taps + t]
+struct Contributions {
+    int taps;
+    std::vector<int> first;
+    std::vector<qint16> weights;
+};
+
+Contributions lanczosContributions(int src_size, int dst_size)
+{
+    const double scale = double(src_size) / dst_size;
+    // the filter is stretched when reducing, to filter out high frequencies
+    const double stretch = std::max(1.0, scale);
+    const double support = kLanczosRadius * stretch;
+
+    Contributions result;
+    result.taps = std::min(int(std::ceil(support)) * 2 + 1, src_size);
+    result.first.resize(dst_size);
+    result.weights.resize(size_t(dst_size) * result.taps);
+
+    std::vector<double> weights(result.taps);
+    for (int i = 0; i < dst_size; ++i) {
+        const double center = (i + 0.5) * scale - 0.5;
+        int first = int(std::floor(center - support)) + 1;
+        first = std::clamp(first, 0, src_size - result.taps);
+        result.first[i] = first;
+
+        double sum = 0;
+        for (int t = 0; t < result.taps; ++t) {
+            weights[t] = lanczos((first + t - center) / stretch);
+            sum += weights[t];
+        }
+        if (sum == 0) {
+            // degenerate sizes, take the nearest sample
+            int nearest = int(std::lround(center)) - first;
+            weights[std::clamp(nearest, 0, result.taps - 1)] = 1;
+            sum = 1;
+        }
+
+        // normalize in fixed point, the rounding error goes to the
+        // largest weight
+        qint16* fixed = &result.weights[size_t(i) * result.taps];
+        int fixed_sum = 0;
+        int largest = 0;
+        for (int t = 0; t < result.taps; ++t) {
+            fixed[t] =
+                qint16(std::lround(weights[t] / sum * (1 << kWeightBits)));
+            fixed_sum += fixed[t];
+            if (std::abs(fixed[t]) > std::abs(fixed[largest])) {
+                largest = t;
+            }
+        }
+        fixed[largest] += (1 << kWeightBits) - fixed_sum;
+    }
+    return result;
+}
+
+QImage lanczosResample(const QImage& src, QSize size)
+{
+    TraceScope trace{"resample::lanczos"};
+
+    const Contributions horizontal =
+        lanczosContributions(src.width(), size.width());
+    const Contributions vertical =
+        lanczosContributions(src.height(), size.height());
+    const qint64 pixels = qint64(src.width()) * src.height();
+    const Kernels& k = kernels();
+
+    // horizontal pass over all the source rows
+    QImage tmp(size.width(), src.height(), src.format());
+    uchar* tmp_bits = tmp.bits();
+    const int tmp_stride = tmp.bytesPerLine();
+    forEachBand(src.height(), pixels, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uchar* in = src.constScanLine(y);
+            uchar* out = tmp_bits + qint64(y) * tmp_stride;
+            k.convolve(
+                in,
+                horizontal.first.data(),
+                horizontal.weights.data(),
+                horizontal.taps,
+                out,
+                size.width());
+        }
+    });
+
+    // vertical pass, vectorized along the rows
+    QImage dst(size, src.format());
+    uchar* dst_bits = dst.bits();
+    const int dst_stride = dst.bytesPerLine();
+    forEachBand(size.height(), pixels, [&](int begin, int end) {
+        std::vector<const uchar*> rows(vertical.taps);
+        for (int y = begin; y < end; ++y) {
+            for (int t = 0; t < vertical.taps; ++t) {
+                rows[t] = tmp.constScanLine(vertical.first[y] + t);
+            }
+            k.filter(
+                rows.data(),
+                &vertical.weights[size_t(y) * vertical.taps],
+                vertical.taps,
+                dst_bits + qint64(y) * dst_stride,
+                size.width() * 4);
+        }
+    });
+
+    // premultiplied colors must not exceed the alpha after ringing
+    if (dst.format() == QImage::Format_ARGB32_Premultiplied) {
+        for (int y = 0; y < dst.height(); ++y) {
+            QRgb* line =
+                reinterpret_cast<QRgb*>(dst_bits + qint64(y) * dst_stride);
+            for (int x = 0; x < dst.width(); ++x) {
+                int a = qAlpha(line[x]);
+                line[x] = qRgba(
+                    std::min(qRed(line[x]), a),
+                    std::min(qGreen(line[x]), a),
+                    std::min(qBlue(line[x]), a),
+                    a);
+            }
+        }
+    }
+    return dst;
+}
+
+// Block size reducing src_size to at least twice dst_size, the Lanczos
+// filter does the rest
+int boxFactor(int src_size, int dst_size)
+{
+    return std::clamp(src_size / (2 * dst_size), 1, kMaxBoxFactor);
+}
+
+} // <anonymous>
+
+QImage resample(const QImage& image, QSize size)
+{
+    if (image.isNull() || size.isEmpty()) {
+        return {};
+    }
+    if (image.size() == size) {
+        return image;
+    }
+
+    // every kernel works on 4 samples of 8 bits per pixel
+    QImage src = image.convertToFormat(
+        image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                : QImage::Format_RGB32);
+
+    int fx = boxFactor(src.width(), size.width());
+    int fy = boxFactor(src.height(), size.height());
+    if (fx > 1 || fy > 1) {
+        src = boxReduce(src, fx, fy);
+    }
+    if (src.size() == size) {
+        return src;
+    }
+    return lanczosResample(src, size);
+}
+
+const char* resampleInstructionSet()
+{
+    return kernels().name;
+}
+
+} // picpic
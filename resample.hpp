@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+
+namespace picpic {
+
+// Resample image to size, ignoring the aspect ratio. Large reductions are
+// first done by averaging blocks of pixels, then a Lanczos filter gives the
+// final size. Kernels use AVX2, SSE4.1 or NEON when the CPU has them, and
+// very large images are processed by bands of rows on several threads.
+// Much faster than QImage::scaled with Qt::SmoothTransformation.
+QImage resample(const QImage& image, QSize size);
+
+// Instruction set the resampling kernels use on this CPU
+const char* resampleInstructionSet();
+
+} // picpic
@@ -0,0 +1,52 @@
+#include "rotator.hpp"
+
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "database.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+Rotator::Rotator(QSqlDatabase db, const Selection& selection, int turns)
+    : Job(selection.size() < 0 ? QString("Rotate pictures")
+                                : QString("Rotate %1 pictures")
+                                      .arg(selection.size()),
+          Resource::kDatabase),
+      cursor_{db, selection},
+      turns_{(turns % 4 + 4) % 4},
+      size_{selection.size()}
+{
+}
+
+Rotator::Step Rotator::step()
+{
+    progress(nr_rotated_, size_);
+
+    QString library;
+    QVector<int> ids;
+    QStringList paths;
+    if (!cursor_.next(&library, &ids, &paths)) {
+        if (!cursor_.errorString().isEmpty()) {
+            error_ = cursor_.errorString();
+            return Step::kFailed;
+        }
+        return success_ ? Step::kDone : Step::kFailed;
+    }
+
+    TraceScope trace{"Rotator::step"};
+    QSqlQuery query(openWorkerDatabase(library));
+    if (!query.exec(
+            QString("UPDATE %1 SET rotation = (rotation + %2) % 4 "
+                    "WHERE id IN (%3)")
+                .arg(kPicturesTable)
+                .arg(turns_)
+                .arg(joinIds(ids)))) {
+        success_ = false;
+        error_ = query.lastError().text();
+    }
+    nr_rotated_ += ids.size();
+    return Step::kContinue;
+}
+
+} // picpic
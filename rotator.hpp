@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QSqlDatabase>
+
+#include "jobs.hpp"
+#include "selection.hpp"
+
+namespace picpic {
+
+// Rotates pictures in their library by clockwise quarter turns, added to
+// the rotation of each of them, on the database thread of the scheduler
+// with its own connection
+class Rotator : public Job {
+    Q_OBJECT
+public:
+    Rotator(QSqlDatabase db, const Selection& selection, int turns);
+    const QString& errorString() const { return error_; }
+
+protected:
+    Step step() override;
+
+private:
+    SelectionCursor cursor_;
+    const int turns_;
+    const int size_;
+    int nr_rotated_{0};
+    QString error_;
+    bool success_{true};
+};
+
+} // picpic
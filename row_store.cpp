@@ -0,0 +1,104 @@
+#include "row_store.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace picpic {
+
+namespace {
+
+qint8 clippedPercent(float clipped)
+{
+    if (clipped < 0) {
+        return -1;
+    }
+    return static_cast<qint8>(std::ceil(std::min(clipped, 100.f)));
+}
+
+} // <anonymous>
+
+void RowStore::clear()
+{
+    *this = RowStore{};
+}
+
+void RowStore::squeeze()
+{
+    ids_.shrink_to_fit();
+    directory_indices_.shrink_to_fit();
+    name_offsets_.shrink_to_fit();
+    names_.squeeze();
+    ratings_.shrink_to_fit();
+    rotations_.shrink_to_fit();
+    sharpness_.shrink_to_fit();
+    clipped_.shrink_to_fit();
+    // only needed while appending
+    directory_indices_by_path_ = {};
+}
+
+void RowStore::append(
+    int id,
+    const QString& path,
+    int rating,
+    int rotation,
+    float sharpness,
+    float clipped)
+{
+    int name_start = path.lastIndexOf('/') + 1;
+    ids_.push_back(id);
+    directory_indices_.push_back(directory(path.left(name_start)));
+    name_offsets_.push_back(static_cast<quint32>(names_.size()));
+    names_ += path.midRef(name_start).toUtf8();
+    ratings_.push_back(static_cast<quint8>(rating));
+    rotations_.push_back(static_cast<quint8>(rotation));
+    sharpness_.push_back(sharpness);
+    clipped_.push_back(clippedPercent(clipped));
+}
+
+void RowStore::setMetrics(int row, float sharpness, float clipped)
+{
+    sharpness_[row] = sharpness;
+    clipped_[row] = clippedPercent(clipped);
+}
+
+QString RowStore::path(int row) const
+{
+    int begin = static_cast<int>(name_offsets_[row]);
+    int end = row + 1 < size() ? static_cast<int>(name_offsets_[row + 1])
+                               : names_.size();
+    return directories_[directory_indices_[row]]
+           + QString::fromUtf8(names_.constData() + begin, end - begin);
+}
+
+qint64 RowStore::memoryUsage() const
+{
+    qint64 bytes = ids_.capacity() * sizeof(int)
+                   + directory_indices_.capacity() * sizeof(quint32)
+                   + name_offsets_.capacity() * sizeof(quint32)
+                   + names_.capacity() + ratings_.capacity()
+                   + rotations_.capacity()
+                   + sharpness_.capacity() * sizeof(float)
+                   + clipped_.capacity();
+    for (const auto& directory : directories_) {
+        bytes += directory.capacity() * sizeof(QChar);
+    }
+    return bytes;
+}
+
+quint32 RowStore::directory(const QString& directory)
+{
+    // rows mostly come sorted by path, in runs of the same directory
+    if (!directory_indices_.empty()
+        && directories_[directory_indices_.back()] == directory) {
+        return directory_indices_.back();
+    }
+    auto it = directory_indices_by_path_.find(directory);
+    if (it == directory_indices_by_path_.end()) {
+        it = directory_indices_by_path_.insert(
+            directory, static_cast<quint32>(directories_.size()));
+        directories_.push_back(directory);
+    }
+    return it.value();
+}
+
+} // picpic
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace picpic {
+
+// Rows of a library, one array per column. The pictures of a library
+// share few directories: each one is stored once and the rows only keep
+// the file name, in UTF-8, so that a row takes about 35 bytes instead of
+// the hundreds of a QSqlRecord. Paths are rebuilt when they are read.
+class RowStore {
+public:
+    void clear();
+    // Release the memory reserved while appending rows
+    void squeeze();
+    // sharpness is NaN and clipped negative for pictures without metrics
+    void append(
+        int id,
+        const QString& path,
+        int rating,
+        int rotation,
+        float sharpness,
+        float clipped);
+
+    int size() const { return static_cast<int>(ids_.size()); }
+    int id(int row) const { return ids_[row]; }
+    QString path(int row) const;
+    int rating(int row) const { return ratings_[row]; }
+    void setRating(int row, int rating) { ratings_[row] = rating; }
+    int rotation(int row) const { return rotations_[row]; }
+    void setRotation(int row, int rotation) { rotations_[row] = rotation; }
+    bool hasMetrics(int row) const { return !std::isnan(sharpness_[row]); }
+    float sharpness(int row) const { return sharpness_[row]; }
+    // percentage, rounded up so that a few clipped pixels do not show as
+    // none, -1 without metrics
+    int clipped(int row) const { return clipped_[row]; }
+    void setMetrics(int row, float sharpness, float clipped);
+
+    // Bytes allocated for the rows
+    qint64 memoryUsage() const;
+
+private:
+    quint32 directory(const QString& directory);
+
+    std::vector<int> ids_;
+    // index in directories_
+    std::vector<quint32> directory_indices_;
+    // the name of a row ends where the one of the next row starts
+    std::vector<quint32> name_offsets_;
+    QByteArray names_;
+    std::vector<quint8> ratings_;
+    std::vector<quint8> rotations_;
+    std::vector<float> sharpness_;
+    std::vector<qint8> clipped_;
+    // with their trailing separator
+    QVector<QString> directories_;
+    QHash<QString, quint32> directory_indices_by_path_;
+};
+
+} // picpic
@@ -0,0 +1,205 @@
+#include "selection.hpp"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QMap>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "database.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+// pictures read at once, it also bounds the length of the IN clauses
+constexpr int kChunkSize = 1000;
+
+} // <anonymous>
+
+Selection Selection::matching(
+    const QString& table,
+    const QString& condition,
+    int size,
+    QVector<int> max_ids)
+{
+    Selection selection;
+    selection.table_ = table;
+    selection.condition_ = condition;
+    selection.max_ids_ = std::move(max_ids);
+    selection.size_ = size;
+    return selection;
+}
+
+Selection Selection::withIds(const QString& table, QVector<int> ids)
+{
+    Selection selection;
+    selection.table_ = table;
+    selection.by_ids_ = true;
+    selection.size_ = ids.size();
+    selection.ids_ = std::move(ids);
+    return selection;
+}
+
+SelectionCursor::SelectionCursor(QSqlDatabase db, const Selection& selection)
+{
+    const bool view = selection.table_ == kAllPicturesView;
+    const QStringList files =
+        view ? libraryFiles(db) : QStringList{db.databaseName()};
+
+    if (!selection.by_ids_) {
+        // the columns of the view are the ones of the libraries
+        QString condition =
+            selection.condition_.isEmpty() ? "1" : selection.condition_;
+        for (int i = 0; i < files.size(); ++i) {
+            if (selection.max_ids_.isEmpty()) {
+                parts_.push_back({files[i], condition});
+            }
+            else if (i < selection.max_ids_.size()) {
+                parts_.push_back(
+                    {files[i],
+                     QString("(%1) AND id <= %2")
+                         .arg(condition)
+                         .arg(selection.max_ids_[i])});
+            }
+        }
+        return;
+    }
+
+    QMap<int, QVector<int>> ids_by_library;
+    for (int id : selection.ids_) {
+        if (view) {
+            ids_by_library[libraryIndex(id)].push_back(libraryId(id));
+        }
+        else {
+            ids_by_library[0].push_back(id);
+        }
+    }
+    for (auto it = ids_by_library.begin(); it != ids_by_library.end(); ++it) {
+        QVector<int>& ids = it.value();
+        std::sort(ids.begin(), ids.end());
+        for (int i = 0; i < ids.size(); i += kChunkSize) {
+            parts_.push_back(
+                {files.value(it.key()),
+                 QString("id IN (%1)").arg(joinIds(ids.mid(i, kChunkSize)))});
+        }
+    }
+}
+
+bool SelectionCursor::next(
+    QString* library,
+    QVector<int>* ids,
+    QStringList* paths,
+    QVector<int>* ratings)
+{
+    ids->clear();
+    paths->clear();
+    if (ratings) {
+        ratings->clear();
+    }
+    while (next_part_ < parts_.size()) {
+        const Part& part = parts_[next_part_];
+        QSqlQuery query(openWorkerDatabase(part.library));
+        query.setForwardOnly(true);
+        query.prepare(QString("SELECT id, path, rating FROM %1 "
+                              "WHERE (%2) AND id > ? ORDER BY id LIMIT %3")
+                          .arg(kPicturesTable, part.condition)
+                          .arg(kChunkSize));
+        query.addBindValue(last_id_);
+        if (!query.exec()) {
+            error_ = query.lastError().text();
+            return false;
+        }
+        while (query.next()) {
+            ids->push_back(query.value(0).toInt());
+            paths->push_back(query.value(1).toString());
+            if (ratings) {
+                ratings->push_back(query.value(2).toInt());
+            }
+        }
+
+        if (ids->size() < kChunkSize) {
+            ++next_part_;
+            last_id_ = -1;
+        }
+        else {
+            last_id_ = ids->back();
+        }
+        if (!ids->isEmpty()) {
+            *library = part.library;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString joinIds(const QVector<int>& ids)
+{
+    QStringList strings;
+    strings.reserve(ids.size());
+    for (int id : ids) {
+        strings.push_back(QString::number(id));
+    }
+    return strings.join(',');
+}
+
+SelectionReader::SelectionReader(
+    QSqlDatabase db, const Selection& selection, PathQueue* output)
+    : Job("Read selection", Resource::kDatabase),
+      cursor_{db, selection},
+      output_{output},
+      size_{selection.size()}
+{
+}
+
+SelectionReader::SelectionReader(
+    QSqlDatabase db, const Selection& selection, RatedPathQueue* output)
+    : Job("Read selection", Resource::kDatabase),
+      cursor_{db, selection},
+      rated_output_{output},
+      size_{selection.size()}
+{
+}
+
+SelectionReader::Step SelectionReader::step()
+{
+    TraceScope trace{"SelectionReader::step"};
+    QString library;
+    QVector<int> ids;
+    QStringList paths;
+    QVector<int> ratings;
+    if (!cursor_.next(
+            &library, &ids, &paths, rated_output_ ? &ratings : nullptr)) {
+        if (output_) {
+            output_->close();
+        }
+        else {
+            rated_output_->close();
+        }
+        if (!cursor_.errorString().isEmpty()) {
+            qDebug() << "failed to read the selection:"
+                     << cursor_.errorString();
+            return Step::kFailed;
+        }
+        return Step::kDone;
+    }
+
+    if (output_) {
+        output_->push(paths);
+    }
+    else {
+        QList<RatedPath> rated;
+        rated.reserve(paths.size());
+        for (int i = 0; i < paths.size(); ++i) {
+            rated.push_back({paths[i], ratings[i]});
+        }
+        rated_output_->push(rated);
+    }
+    nr_read_ += paths.size();
+    progress(nr_read_, size_);
+    return Step::kContinue;
+}
+
+} // picpic
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "jobs.hpp"
+
+namespace picpic {
+
+// Pictures chosen for a bulk operation. The jobs read them from the
+// libraries in SQL rather than from the rows of a model, so that
+// selecting a whole library does not list it.
+class Selection {
+public:
+    Selection() = default;
+
+    // Pictures of table, kPicturesTable or kAllPicturesView, matching
+    // condition: a SQL expression on the path, rating, rotation, sharpness
+    // and clipped columns, all of them when it is empty. When max_ids is
+    // given, it is the largest id of each library, in the order of
+    // libraryFiles: the pictures added after are left out.
+    static Selection matching(
+        const QString& table,
+        const QString& condition,
+        int size = -1,
+        QVector<int> max_ids = {});
+    // Pictures of table with these ids
+    static Selection withIds(const QString& table, QVector<int> ids);
+
+    const QString& table() const { return table_; }
+    // number of pictures, -1 when unknown
+    int size() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+
+private:
+    friend class SelectionCursor;
+
+    QString table_;
+    QString condition_;
+    QVector<int> ids_;
+    QVector<int> max_ids_;
+    bool by_ids_{false};
+    int size_{0};
+};
+
+// Reads the pictures of a selection library after library, in chunks in
+// the order of their ids. The chunks are read again from where the last
+// one ended: the jobs may delete or rate the pictures meanwhile.
+class SelectionCursor {
+public:
+    // Called on the thread of db, which lists the libraries
+    SelectionCursor(QSqlDatabase db, const Selection& selection);
+
+    // Next pictures of a library, read with the connection of the calling
+    // thread: see openWorkerDatabase. Returns false once they were all
+    // read, or on error.
+    bool next(
+        QString* library,
+        QVector<int>* ids,
+        QStringList* paths,
+        QVector<int>* ratings = nullptr);
+    const QString& errorString() const { return error_; }
+
+private:
+    struct Part {
+        QString library;
+        QString condition;
+    };
+
+    QVector<Part> parts_;
+    int next_part_{0};
+    int last_id_{-1};
+    QString error_;
+};
+
+// Comma separated, for IN clauses
+QString joinIds(const QVector<int>& ids);
+
+// First stage of the bulk operations on files: the paths of the selected
+// pictures are pushed to output, which is closed once they all are
+class SelectionReader : public Job {
+    Q_OBJECT
+public:
+    SelectionReader(
+        QSqlDatabase db, const Selection& selection, PathQueue* output);
+    // With the ratings of the pictures
+    SelectionReader(
+        QSqlDatabase db, const Selection& selection, RatedPathQueue* output);
+
+protected:
+    Step step() override;
+
+private:
+    SelectionCursor cursor_;
+    PathQueue* output_{nullptr};
+    RatedPathQueue* rated_output_{nullptr};
+    const int size_;
+    int nr_read_{0};
+};
+
+} // picpic
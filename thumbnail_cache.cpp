@@ -0,0 +1,75 @@
+#include "thumbnail_cache.hpp"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace picpic {
+
+namespace {
+
+constexpr int kThumbnailQuality = 90;
+
+QString cachePath(const QString& path)
+{
+    static const QString root =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/thumbnails/";
+
+    // the key changes whenever the picture is modified
+    QFileInfo info{path};
+    QByteArray key = info.absoluteFilePath().toUtf8();
+    key += '\n' + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+    key += '\n' + QByteArray::number(info.size());
+
+    QString hash = QString::fromLatin1(
+        QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+    // spread files over subdirectories, libraries can be huge
+    return root + hash.left(2) + '/' + hash.mid(2);
+}
+
+} // <anonymous>
+
+QImage loadCachedThumbnail(const QString& path)
+{
+    // the format is detected from the content, PNG or JPEG
+    QImageReader reader{cachePath(path)};
+    return reader.read();
+}
+
+bool hasCachedThumbnail(const QString& path)
+{
+    return QFileInfo::exists(cachePath(path));
+}
+
+void storeCachedThumbnail(const QString& path, const QImage& thumbnail)
+{
+    if (thumbnail.isNull()) {
+        return;
+    }
+
+    QString file_path = cachePath(path);
+    QDir().mkpath(QFileInfo(file_path).path());
+
+    QSaveFile file{file_path};
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "failed to cache thumbnail of" << path << ":"
+                 << file.errorString();
+        return;
+    }
+
+    QImageWriter writer{&file, thumbnail.hasAlphaChannel() ? "png" : "jpg"};
+    writer.setQuality(kThumbnailQuality);
+    if (!writer.write(thumbnail) || !file.commit()) {
+        qDebug() << "failed to cache thumbnail of" << path << ":"
+                 << writer.errorString();
+    }
+}
+
+} // picpic
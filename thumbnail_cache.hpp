@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+
+namespace picpic {
+
+// Thumbnails are persisted on disk at this size, smaller ones are
+// downscaled from it
+constexpr int kThumbnailCacheSize = 256;
+
+// Return the cached thumbnail of the picture at path, or a null image if it
+// has not been cached yet or the picture changed since.
+QImage loadCachedThumbnail(const QString& path);
+// Cheaper than loading it, the thumbnail may still be unreadable
+bool hasCachedThumbnail(const QString& path);
+void storeCachedThumbnail(const QString& path, const QImage& thumbnail);
+
+} // picpic
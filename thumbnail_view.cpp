@@ -0,0 +1,141 @@
+#include "thumbnail_view.hpp"
+
+#include <algorithm>
+
+#include <QPainter>
+#include <QStyle>
+#include <QStyledItemDelegate>
+
+#include "pic_model.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kPadding = 4;
+constexpr ushort kStar = 0x2605;
+
+QSize cellSize(int thumbnail_size, const QFontMetrics& metrics)
+{
+    return QSize(
+        thumbnail_size + 2 * kPadding,
+        thumbnail_size + 2 * kPadding + metrics.height());
+}
+
+// Paints a cell without allocating any widget: thumbnail and rating
+class ThumbnailDelegate : public QStyledItemDelegate {
+public:
+    ThumbnailDelegate(int thumbnail_size, QObject* parent)
+        : QStyledItemDelegate(parent), thumbnail_size_{thumbnail_size}
+    {
+    }
+
+    void paint(
+        QPainter* painter,
+        const QStyleOptionViewItem& option,
+        const QModelIndex& index) const override
+    {
+        painter->save();
+
+        bool selected = option.state & QStyle::State_Selected;
+        if (selected) {
+            painter->fillRect(option.rect, option.palette.highlight());
+        }
+
+        QRect cell =
+            option.rect.adjusted(kPadding, kPadding, -kPadding, -kPadding);
+        QRect thumbnail_rect(
+            cell.topLeft(), QSize(thumbnail_size_, thumbnail_size_));
+        QRect text_rect = cell;
+        text_rect.setTop(thumbnail_rect.bottom() + 1);
+
+        QPixmap thumbnail = index.data(Qt::DecorationRole).value<QPixmap>();
+        if (!thumbnail.isNull()) {
+            QSize size = thumbnail.size();
+            if (size.width() > thumbnail_rect.width()
+                || size.height() > thumbnail_rect.height()) {
+                size.scale(thumbnail_rect.size(), Qt::KeepAspectRatio);
+            }
+            QRect target{QPoint(), size};
+            target.moveCenter(thumbnail_rect.center());
+            painter->drawPixmap(target, thumbnail);
+        }
+
+        int rating =
+            index.sibling(index.row(), PicModel::kColRating).data().toInt();
+        painter->setPen(
+            selected ? option.palette.highlightedText().color()
+                     : option.palette.text().color());
+        painter->drawText(
+            text_rect, Qt::AlignCenter, QString(rating, QChar(kStar)));
+
+        painter->restore();
+    }
+
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex&)
+        const override
+    {
+        return cellSize(thumbnail_size_, option.fontMetrics);
+    }
+
+private:
+    int thumbnail_size_;
+};
+
+} // <anonymous>
+
+ThumbnailView::ThumbnailView(int thumbnail_size, QWidget* parent)
+    : QListView(parent), thumbnail_size_{thumbnail_size}
+{
+    setViewMode(QListView::ListMode);
+    setFlow(QListView::LeftToRight);
+    setWrapping(true);
+    setResizeMode(QListView::Adjust);
+    setMovement(QListView::Static);
+    setUniformItemSizes(true);
+    setGridSize(cellSize(thumbnail_size_, fontMetrics()));
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
+    setEditTriggers(QAbstractItemView::NoEditTriggers);
+    setItemDelegate(new ThumbnailDelegate(thumbnail_size_, this));
+}
+
+void ThumbnailView::setModel(QAbstractItemModel* model)
+{
+    QListView::setModel(model);
+    setModelColumn(PicModel::kColPath);
+}
+
+void ThumbnailView::paintEvent(QPaintEvent* event)
+{
+    // thumbnails of the visible cells are requested while painting them
+    QListView::paintEvent(event);
+
+    PicModel* pic_model = qobject_cast<PicModel*>(model());
+    if (!pic_model) {
+        return;
+    }
+
+    QSize grid = gridSize();
+    QModelIndex top = indexAt(QPoint(grid.width() / 2, grid.height() / 2));
+    if (!top.isValid()) {
+        return;
+    }
+    int columns = std::max(1, viewport()->width() / grid.width());
+    QModelIndex bottom =
+        indexAt(QPoint(grid.width() / 2, viewport()->height() - 1));
+    int first = top.row();
+    int last = bottom.isValid() ? bottom.row() + columns - 1
+                                : pic_model->rowCount() - 1;
+
+    pic_model->setVisibleRows(first, last);
+}
+
+QItemSelectionModel::SelectionFlags ThumbnailView::selectionCommand(
+    const QModelIndex& index, const QEvent* event) const
+{
+    // the selection is shared with the table view, which selects rows
+    return QListView::selectionCommand(index, event)
+           | QItemSelectionModel::Rows;
+}
+
+} // picpic
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QListView>
+
+namespace picpic {
+
+// Grid of thumbnails over a PicModel. Only the visible cells are painted,
+// by a delegate, and thumbnails are requested for the visible cells and
+// the ones just around them.
+class ThumbnailView : public QListView {
+    Q_OBJECT
+public:
+    ThumbnailView(int thumbnail_size, QWidget* parent = nullptr);
+    void setModel(QAbstractItemModel* model) override;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    QItemSelectionModel::SelectionFlags selectionCommand(
+        const QModelIndex& index,
+        const QEvent* event = nullptr) const override;
+
+private:
+    int thumbnail_size_;
+};
+
+} // picpic
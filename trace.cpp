@@ -0,0 +1,198 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace picpic {
+
+namespace {
+
+constexpr int kRingSize = 1 << 14;
+
+constexpr const char* kCounterNames[] = {
+    "decodes",
+    "thumbnail_cache_hits",
+    "thumbnail_cache_misses",
+    "pixmap_cache_hits",
+    "pixmap_cache_misses",
+    "loader_queue_depth",
+    "scanned_files",
+    "inserted_rows",
+    "deleted_rows",
+    "exported_bytes",
+    "prefetched_bytes",
+    "sidecars_read",
+    "sidecars_written",
+};
+static_assert(
+    sizeof(kCounterNames) / sizeof(kCounterNames[0])
+    == static_cast<size_t>(Counter::kCount));
+
+// The sequence is odd while the slot is being written and 2 * (index + 1)
+// once event number index is in it. Readers skip the slots whose sequence
+// changed while they copied them.
+struct Slot {
+    std::atomic<quint64> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<qint64> begin_ns{0};
+    std::atomic<qint64> duration_ns{0};
+    std::atomic<int> thread{0};
+};
+
+std::atomic<bool> tracing_enabled{false};
+std::atomic<qint64> counters[static_cast<int>(Counter::kCount)];
+std::atomic<quint64> head{0};
+Slot slots[kRingSize];
+std::atomic<int> nr_threads{0};
+
+qint64 now()
+{
+    using Clock = std::chrono::steady_clock;
+    static const Clock::time_point epoch = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now() - epoch)
+        .count();
+}
+
+int threadId()
+{
+    thread_local int id = ++nr_threads;
+    return id;
+}
+
+void record(const char* name, qint64 begin_ns, qint64 duration_ns)
+{
+    quint64 index = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[index % kRingSize];
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+    slot.thread.store(threadId(), std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+} // <anonymous>
+
+void addToCounter(Counter counter, qint64 delta)
+{
+    counters[static_cast<int>(counter)].fetch_add(
+        delta, std::memory_order_relaxed);
+}
+
+qint64 counterValue(Counter counter)
+{
+    return counters[static_cast<int>(counter)].load(std::memory_order_relaxed);
+}
+
+const char* counterName(Counter counter)
+{
+    return kCounterNames[static_cast<int>(counter)];
+}
+
+void setTracingEnabled(bool enabled)
+{
+    tracing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool tracingEnabled()
+{
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+QVector<TraceEvent> traceEvents()
+{
+    quint64 end = head.load(std::memory_order_acquire);
+    quint64 begin = end > kRingSize ? end - kRingSize : 0;
+
+    QVector<TraceEvent> events;
+    events.reserve(end - begin);
+    for (quint64 index = begin; index < end; ++index) {
+        const Slot& slot = slots[index % kRingSize];
+        quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+            // still being written or already overwritten
+            continue;
+        }
+        TraceEvent event{
+            slot.name.load(std::memory_order_relaxed),
+            slot.begin_ns.load(std::memory_order_relaxed),
+            slot.duration_ns.load(std::memory_order_relaxed),
+            slot.thread.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+            events.push_back(event);
+        }
+    }
+    return events;
+}
+
+bool writeChromeTrace(const QString& path)
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray trace_events;
+    for (const TraceEvent& event : traceEvents()) {
+        // timestamps are in microseconds
+        trace_events.append(QJsonObject{
+            {"name", event.name},
+            {"cat", "picpic"},
+            {"ph", "X"},
+            {"ts", event.begin_ns / 1e3},
+            {"dur", event.duration_ns / 1e3},
+            {"pid", pid},
+            {"tid", event.thread},
+        });
+    }
+
+    QJsonObject args;
+    for (int i = 0; i < static_cast<int>(Counter::kCount); ++i) {
+        args[kCounterNames[i]] = counterValue(static_cast<Counter>(i));
+    }
+    trace_events.append(QJsonObject{
+        {"name", "counters"},
+        {"ph", "C"},
+        {"ts", now() / 1e3},
+        {"pid", pid},
+        {"args", args},
+    });
+
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "failed to write trace" << path << ":"
+                 << file.errorString();
+        return false;
+    }
+    file.write(
+        QJsonDocument(QJsonObject{{"traceEvents", trace_events}}).toJson(
+            QJsonDocument::Compact));
+    if (!file.commit()) {
+        qDebug() << "failed to write trace" << path << ":"
+                 << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+TraceScope::TraceScope(const char* name)
+    : name_{name}, begin_ns_{tracingEnabled() ? now() : -1}
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (begin_ns_ >= 0) {
+        record(name_, begin_ns_, now() - begin_ns_);
+    }
+}
+
+} // picpic
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+namespace picpic {
+
+// Counters are always updated, they are relaxed atomic additions. Gauges
+// such as queue depths are counters going up and down.
+enum class Counter {
+    kDecodes,
+    kThumbnailCacheHits,
+    kThumbnailCacheMisses,
+    kPixmapCacheHits,
+    kPixmapCacheMisses,
+    kLoaderQueueDepth,
+    kScannedFiles,
+    kInsertedRows,
+    kDeletedRows,
+    kExportedBytes,
+    kPrefetchedBytes,
+    kSidecarsRead,
+    kSidecarsWritten,
+    kCount
+};
+
+void addToCounter(Counter counter, qint64 delta = 1);
+qint64 counterValue(Counter counter);
+const char* counterName(Counter counter);
+
+constexpr const char* kDecodeTrace = "ImageLoader::decode";
+
+struct TraceEvent {
+    const char* name;
+    qint64 begin_ns;
+    qint64 duration_ns;
+    int thread;
+};
+
+// Events are only recorded while tracing is enabled, in a fixed size ring
+// buffer written without locks: the oldest events are overwritten.
+void setTracingEnabled(bool enabled);
+bool tracingEnabled();
+// Recorded events still in the ring buffer, oldest first
+QVector<TraceEvent> traceEvents();
+// Write the recorded events and the counters in the Chrome trace event
+// format, to be opened with chrome://tracing or Perfetto
+bool writeChromeTrace(const QString& path);
+
+// Records the duration of the enclosing scope. name is not copied, it must
+// be a string literal.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    // -1 when tracing was disabled on construction
+    qint64 begin_ns_;
+};
+
+} // picpic
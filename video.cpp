@@ -0,0 +1,129 @@
+#include "video.hpp"
+
+#include <QFileInfo>
+#include <QProcess>
+#include <QSet>
+#include <QStandardPaths>
+
+#include "logging.hpp"
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+// a keyframe decodes in well under a second, even from 4K clips
+constexpr int kDecodeTimeoutMs = 10000;
+
+// Decoders of video clips, one is chosen when the first clip is decoded
+struct Backend {
+    QImage (*decode_keyframe)(const QString& path, QSize bound);
+    const char* name;
+};
+
+// without a decoder, the clips are not scanned
+QImage decodeKeyframeNone(const QString&, QSize)
+{
+    return {};
+}
+
+const QString& ffmpegProgram()
+{
+    static const QString program = QStandardPaths::findExecutable("ffmpeg");
+    return program;
+}
+
+// The ffmpeg tool decodes the first keyframe alone, skipping every other
+// frame, and writes it as a PPM image. It applies the display matrix of
+// the clip and stretches anamorphic clips before scaling them down to
+// bound.
+QImage decodeKeyframeFfmpeg(const QString& path, QSize bound)
+{
+    QString filters = "scale=iw*sar:ih";
+    if (bound.isValid()) {
+        filters += QString(",scale=w=min(iw\\,%1):h=min(ih\\,%2)"
+                           ":force_original_aspect_ratio=decrease")
+                       .arg(bound.width())
+                       .arg(bound.height());
+    }
+
+    QProcess ffmpeg;
+    ffmpeg.setProcessChannelMode(QProcess::SeparateChannels);
+    // the loaders already decode on several threads
+    ffmpeg.start(
+        ffmpegProgram(),
+        {"-nostdin",
+         "-v",
+         "error",
+         "-threads",
+         "1",
+         "-skip_frame",
+         "nokey",
+         "-i",
+         path,
+         "-map",
+         "0:v:0",
+         "-frames:v",
+         "1",
+         "-vf",
+         filters,
+         "-f",
+         "image2pipe",
+         "-c:v",
+         "ppm",
+         "-"});
+    if (!ffmpeg.waitForFinished(kDecodeTimeoutMs)) {
+        qCDebug(lcLoader) << "cannot decode the keyframe of" << path << ":"
+                          << ffmpeg.errorString();
+        ffmpeg.kill();
+        ffmpeg.waitForFinished();
+        return {};
+    }
+    if (ffmpeg.exitStatus() != QProcess::NormalExit
+        || ffmpeg.exitCode() != 0) {
+        qCDebug(lcLoader) << "cannot decode the keyframe of" << path << ":"
+                          << ffmpeg.readAllStandardError().trimmed();
+        return {};
+    }
+    return QImage::fromData(ffmpeg.readAllStandardOutput(), "PPM");
+}
+
+Backend detectBackend()
+{
+    if (ffmpegProgram().isEmpty()) {
+        return {decodeKeyframeNone, "none"};
+    }
+    return {decodeKeyframeFfmpeg, "ffmpeg"};
+}
+
+const Backend& backend()
+{
+    static const Backend backend = detectBackend();
+    return backend;
+}
+
+} // <anonymous>
+
+bool isVideoFile(const QString& path)
+{
+    static const QSet<QString> suffixes{"mov", "mp4", "m4v", "3gp"};
+    return suffixes.contains(QFileInfo(path).suffix().toLower());
+}
+
+bool hasVideoBackend()
+{
+    return backend().decode_keyframe != decodeKeyframeNone;
+}
+
+QImage decodeVideoKeyframe(const QString& path, QSize bound)
+{
+    TraceScope trace{"decodeVideoKeyframe"};
+    return backend().decode_keyframe(path, bound);
+}
+
+const char* videoBackendName()
+{
+    return backend().name;
+}
+
+} // picpic
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+namespace picpic {
+
+// Video clips, such as the MOV and MP4 files of phones, are shown through
+// their first keyframe. It is the only frame decoded: the rest of the clip
+// is never read.
+bool isVideoFile(const QString& path);
+
+// Whether the clips can be decoded: the ffmpeg tool is looked up in the
+// PATH. The clips are not scanned without it.
+bool hasVideoBackend();
+
+// First keyframe of the clip at path, rotated as the clip is played and
+// scaled down by the decoder to fit in bound when it is valid. A null
+// image when it cannot be decoded, or without a video backend.
+QImage decodeVideoKeyframe(const QString& path, QSize bound);
+
+// Backend found at run time, "ffmpeg" or "none"
+const char* videoBackendName();
+
+} // picpic
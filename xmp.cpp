@@ -0,0 +1,249 @@
+#include "xmp.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include <QByteArray>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringList>
+
+#include "trace.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kMaxRating = 5;
+constexpr char kRatingProperty[] = "xmp:Rating";
+constexpr qint64 kRatingPropertyLength = sizeof(kRatingProperty) - 1;
+constexpr char kDescriptionTag[] = "<rdf:Description";
+constexpr char kXmpNamespaceAttribute[] = "xmlns:xmp=";
+constexpr char kXmpNamespace[] =
+    " xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\"";
+// sidecars are read by chunks, the end of a chunk is read again with the
+// next one so that a property cut by it is found there
+constexpr qint64 kChunkSize = 4096;
+constexpr qint64 kChunkOverlap = 64;
+
+// created for the rated pictures without a sidecar, the rating goes in
+// between
+constexpr char kSidecarHead[] =
+    "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n"
+    "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">\n"
+    " <rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n"
+    "  <rdf:Description rdf:about=\"\"\n"
+    "    xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\"\n"
+    "   xmp:Rating=\"";
+constexpr char kSidecarTail[] =
+    "\"/>\n"
+    " </rdf:RDF>\n"
+    "</x:xmpmeta>\n"
+    "<?xpacket end=\"w\"?>\n";
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool isNameChar(char c)
+{
+    return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+           || c == '_' || c == '-' || c == ':' || c == '.';
+}
+
+const char* skipSpaces(const char* it, const char* end)
+{
+    while (it != end && isSpace(*it)) {
+        ++it;
+    }
+    return it;
+}
+
+// IMG_1.xmp first, then IMG_1.jpg.xmp
+QStringList sidecarCandidates(const QString& picture)
+{
+    QStringList candidates;
+    int dot = picture.lastIndexOf('.');
+    if (dot > picture.lastIndexOf('/') + 1) {
+        candidates.push_back(picture.left(dot) + ".xmp");
+    }
+    candidates.push_back(picture + ".xmp");
+    return candidates;
+}
+
+int readRating(QFile& file)
+{
+    char buffer[kChunkOverlap + kChunkSize];
+    qint64 kept = 0;
+    qint64 read = 0;
+    while ((read = file.read(buffer + kept, kChunkSize)) > 0) {
+        qint64 size = kept + read;
+        XmpRating rating;
+        if (findXmpRating(buffer, size, &rating)) {
+            return std::clamp(rating.value, 0, kMaxRating);
+        }
+        kept = std::min(size, kChunkOverlap);
+        std::memmove(buffer, buffer + size - kept, kept);
+    }
+    return -1;
+}
+
+// Add the property to the first description of the packet, with its
+// namespace unless that element declares it already
+bool insertRating(QByteArray& xmp, const QByteArray& value)
+{
+    int description = xmp.indexOf(kDescriptionTag);
+    int tag_end = description < 0 ? -1 : xmp.indexOf('>', description);
+    if (tag_end < 0) {
+        return false;
+    }
+    QByteArray attributes = QByteArray(" ") + kRatingProperty + "=\"" + value
+                            + '"';
+    int declaration = xmp.indexOf(kXmpNamespaceAttribute, description);
+    if (declaration < 0 || declaration > tag_end) {
+        attributes.prepend(kXmpNamespace);
+    }
+    xmp.insert(description + int(sizeof(kDescriptionTag) - 1), attributes);
+    return true;
+}
+
+} // <anonymous>
+
+bool findXmpRating(const char* data, qint64 size, XmpRating* rating)
+{
+    const char* const end = data + size;
+    const std::boyer_moore_horspool_searcher searcher{
+        kRatingProperty, kRatingProperty + kRatingPropertyLength};
+    for (const char* it = data;
+         (it = std::search(it, end, searcher)) != end;) {
+        const char* name = it;
+        it += kRatingPropertyLength;
+        // xmp:RatingPercent or myxmp:Rating
+        if ((name != data && isNameChar(name[-1]))
+            || (it != end && isNameChar(*it))) {
+            continue;
+        }
+
+        // xmp:Rating="3" or <xmp:Rating>3</xmp:Rating>
+        const char* value = skipSpaces(it, end);
+        char terminator = '<';
+        if (value != end && *value == '=') {
+            value = skipSpaces(value + 1, end);
+            if (value == end || (*value != '"' && *value != '\'')) {
+                continue;
+            }
+            terminator = *value++;
+        }
+        else if (value != end && *value == '>') {
+            value = skipSpaces(value + 1, end);
+        }
+        else {
+            // the closing tag, or cut
+            continue;
+        }
+
+        const char* digits = value != end && *value == '-' ? value + 1 : value;
+        const char* value_end = digits;
+        int number = 0;
+        while (value_end != end && isDigit(*value_end)) {
+            number = std::min(number * 10 + (*value_end - '0'), 1000);
+            ++value_end;
+        }
+        // Lightroom may write 3.0, the fraction is kept as is
+        const char* last = value_end;
+        while (last != end && (isDigit(*last) || *last == '.')) {
+            ++last;
+        }
+        const char* after = skipSpaces(last, end);
+        if (value_end == digits || after == end || *after != terminator) {
+            continue;
+        }
+        rating->begin = value - data;
+        rating->end = last - data;
+        rating->value = digits != value ? -number : number;
+        return true;
+    }
+    return false;
+}
+
+QString sidecarPath(const QString& picture)
+{
+    const QStringList candidates = sidecarCandidates(picture);
+    for (const auto& candidate : candidates) {
+        if (QFile::exists(candidate)) {
+            return candidate;
+        }
+    }
+    return candidates.front();
+}
+
+int readSidecarRating(const QString& picture)
+{
+    // opening a missing file fails as fast as checking that it exists
+    for (const auto& candidate : sidecarCandidates(picture)) {
+        QFile file{candidate};
+        if (file.open(QIODevice::ReadOnly)) {
+            addToCounter(Counter::kSidecarsRead);
+            return readRating(file);
+        }
+    }
+    return -1;
+}
+
+SidecarWrite writeSidecarRating(const QString& picture, int rating)
+{
+    TraceScope trace{"writeSidecarRating"};
+    const QString path = sidecarPath(picture);
+    const QByteArray value = QByteArray::number(rating);
+
+    QByteArray xmp;
+    QFile file{path};
+    if (file.open(QIODevice::ReadOnly)) {
+        addToCounter(Counter::kSidecarsRead);
+        xmp = file.readAll();
+        file.close();
+
+        XmpRating found;
+        if (findXmpRating(xmp.constData(), xmp.size(), &found)) {
+            // rejected pictures are not rated here, they stay rejected
+            if (std::clamp(found.value, 0, kMaxRating) == rating) {
+                return SidecarWrite::kUnchanged;
+            }
+            xmp.replace(
+                int(found.begin), int(found.end - found.begin), value);
+        }
+        else if (rating == 0) {
+            return SidecarWrite::kUnchanged;
+        }
+        else if (!insertRating(xmp, value)) {
+            qDebug() << "cannot add a rating to" << path;
+            return SidecarWrite::kFailed;
+        }
+    }
+    else if (rating == 0) {
+        return SidecarWrite::kUnchanged;
+    }
+    else {
+        xmp = kSidecarHead + value + kSidecarTail;
+    }
+
+    // the other tools never see a partly written sidecar
+    QSaveFile save{path};
+    if (!save.open(QIODevice::WriteOnly) || save.write(xmp) != xmp.size()
+        || !save.commit()) {
+        qDebug() << "failed to write" << path << ":" << save.errorString();
+        return SidecarWrite::kFailed;
+    }
+    addToCounter(Counter::kSidecarsWritten);
+    return SidecarWrite::kWritten;
+}
+
+} // picpic
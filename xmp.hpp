@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QString>
+
+namespace picpic {
+
+// Ratings are shared with other tools through XMP sidecars: IMG_1.xmp next
+// to IMG_1.jpg, as written by Lightroom, or IMG_1.jpg.xmp, as written by
+// darktable. Only the xmp:Rating property is read and written, the rest of
+// the sidecar is left as is.
+
+// Position of the value of the xmp:Rating property in a packet
+struct XmpRating {
+    qint64 begin{0};
+    qint64 end{0};
+    // -1 for rejected pictures, as in XMP
+    int value{0};
+};
+
+// Find the rating in the packet without parsing its XML, as an attribute
+// or an element. It is not found when its value is cut by the end of data.
+bool findXmpRating(const char* data, qint64 size, XmpRating* rating);
+
+// Sidecar of a picture: the existing one, or the one to create
+QString sidecarPath(const QString& picture);
+
+// Rating of the picture in its sidecar, from 0 to 5: rejected pictures are
+// not rated. -1 when there is no sidecar or no rating in it. The sidecar is
+// read by chunks until the rating is found.
+int readSidecarRating(const QString& picture);
+
+enum class SidecarWrite {
+    kUnchanged,
+    kWritten,
+    kFailed,
+};
+
+// Set the rating of the picture in its sidecar. Sidecars are only created
+// for rated pictures, and only rewritten when the rating changes.
+SidecarWrite writeSidecarRating(const QString& picture, int rating);
+
+} // picpic
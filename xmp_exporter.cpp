@@ -0,0 +1,53 @@
+#include "xmp_exporter.hpp"
+
+#include "trace.hpp"
+#include "xmp.hpp"
+
+namespace picpic {
+
+namespace {
+
+// most sidecars are unchanged, they are only read
+constexpr int kFilesPerStep = 64;
+
+} // <anonymous>
+
+XmpExporter::XmpExporter(QSqlDatabase db, const Selection& selection)
+    : Job(selection.size() < 0
+              ? QString("Write XMP sidecars")
+              : QString("Write %1 XMP sidecars").arg(selection.size()),
+          Resource::kDisk),
+      size_{selection.size()}
+{
+    addUpstream(new SelectionReader(db, selection, &pictures_));
+}
+
+XmpExporter::Step XmpExporter::step()
+{
+    progress(nr_pictures_, size_);
+    QList<RatedPath> pictures = pictures_.take(kFilesPerStep);
+    if (pictures.isEmpty()) {
+        if (!pictures_.isDone()) {
+            return Step::kWait;
+        }
+        return nr_failed_ == 0 ? Step::kDone : Step::kFailed;
+    }
+
+    TraceScope trace{"XmpExporter::step"};
+    for (const auto& picture : pictures) {
+        switch (writeSidecarRating(picture.path, picture.rating)) {
+        case SidecarWrite::kWritten:
+            ++nr_written_;
+            break;
+        case SidecarWrite::kFailed:
+            ++nr_failed_;
+            break;
+        case SidecarWrite::kUnchanged:
+            break;
+        }
+    }
+    nr_pictures_ += pictures.size();
+    return Step::kContinue;
+}
+
+} // picpic
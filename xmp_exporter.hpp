@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QSqlDatabase>
+
+#include "jobs.hpp"
+#include "selection.hpp"
+
+namespace picpic {
+
+// Writes the ratings of pictures to their XMP sidecars, for the tools
+// reading them. The pictures and their ratings are read from the libraries
+// by a SelectionReader stage. It fails unless all sidecars are written.
+class XmpExporter : public Job {
+    Q_OBJECT
+public:
+    XmpExporter(QSqlDatabase db, const Selection& selection);
+    int nrWritten() const { return nr_written_; }
+    int nrFailed() const { return nr_failed_; }
+
+protected:
+    Step step() override;
+
+private:
+    RatedPathQueue pictures_{this};
+    const int size_;
+    int nr_pictures_{0};
+    int nr_written_{0};
+    int nr_failed_{0};
+};
+
+} // picpic
@@ -0,0 +1,114 @@
+#include "xmp_importer.hpp"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "database.hpp"
+#include "trace.hpp"
+#include "xmp.hpp"
+
+namespace picpic {
+
+namespace {
+
+constexpr int kBatchSize = 500;
+// missing sidecars cost a failed open each
+constexpr int kFilesPerStep = 256;
+
+} // <anonymous>
+
+XmpImporter::XmpImporter(QSqlDatabase db, const Selection& selection)
+    : Job(selection.size() < 0
+              ? QString("Read XMP sidecars")
+              : QString("Read %1 XMP sidecars").arg(selection.size()),
+          Resource::kDatabase),
+      libraries_{libraryFiles(db)}
+{
+    auto reader = new XmpReader(&rated_);
+    reader->addUpstream(new SelectionReader(db, selection, reader->input()));
+    addUpstream(reader);
+}
+
+XmpImporter::Step XmpImporter::step()
+{
+    progress(nr_imported_, -1);
+    QList<RatedPath> pictures = rated_.take(kBatchSize);
+    if (pictures.isEmpty()) {
+        if (!rated_.isDone()) {
+            return Step::kWait;
+        }
+        qDebug() << "imported" << nr_imported_ << "ratings";
+        return success_ ? Step::kDone : Step::kFailed;
+    }
+
+    TraceScope trace{"XmpImporter::step"};
+    // paths are unique in a library, it may be in several of them
+    for (const auto& library : libraries_) {
+        QSqlDatabase db = openWorkerDatabase(library);
+        QSqlQuery query(db);
+        query.prepare(QString("UPDATE %1 SET rating = ? "
+                              "WHERE path = ? AND rating IS NOT ?")
+                          .arg(kPicturesTable));
+
+        if (!db.transaction()) {
+            qDebug() << "failed to import ratings in" << library << ":"
+                     << db.lastError().text();
+            success_ = false;
+            continue;
+        }
+
+        int nr_imported = 0;
+        for (const auto& picture : pictures) {
+            query.bindValue(0, picture.rating);
+            query.bindValue(1, picture.path);
+            query.bindValue(2, picture.rating);
+            if (!query.exec()) {
+                qDebug() << "failed to rate" << picture.path << ":"
+                         << query.lastError().text();
+                success_ = false;
+                continue;
+            }
+            nr_imported += query.numRowsAffected();
+        }
+        if (!db.commit()) {
+            qDebug() << "failed to import ratings in" << library << ":"
+                     << db.lastError().text();
+            db.rollback();
+            success_ = false;
+            continue;
+        }
+        nr_imported_ += nr_imported;
+    }
+    return Step::kContinue;
+}
+
+XmpReader::XmpReader(RatedPathQueue* output)
+    : Job("Read sidecars", Resource::kDisk), output_{output}
+{
+}
+
+XmpReader::Step XmpReader::step()
+{
+    QStringList paths = input_.take(kFilesPerStep);
+    if (paths.isEmpty()) {
+        if (!input_.isDone()) {
+            return Step::kWait;
+        }
+        output_->close();
+        return Step::kDone;
+    }
+
+    TraceScope trace{"XmpReader::step"};
+    QList<RatedPath> rated;
+    for (const auto& path : paths) {
+        int rating = readSidecarRating(path);
+        if (rating >= 0) {
+            rated.push_back({path, rating});
+        }
+    }
+    output_->push(rated);
+    return Step::kContinue;
+}
+
+} // picpic
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QSqlDatabase>
+#include <QStringList>
+
+#include "jobs.hpp"
+#include "selection.hpp"
+
+namespace picpic {
+
+// Sets the ratings of pictures to the ones of their XMP sidecars, for the
+// pictures rated by other tools. Their paths are read by a SelectionReader
+// stage, their sidecars by a XmpReader stage, and the ratings are written
+// on the database thread of the scheduler, to every library holding the
+// picture.
+class XmpImporter : public Job {
+    Q_OBJECT
+public:
+    XmpImporter(QSqlDatabase db, const Selection& selection);
+    // pictures whose rating changed
+    int nrImported() const { return nr_imported_; }
+
+protected:
+    Step step() override;
+
+private:
+    const QStringList libraries_;
+    RatedPathQueue rated_{this};
+    int nr_imported_{0};
+    bool success_{true};
+};
+
+// Stage of the imports: the ratings of the sidecars of the pictures pushed
+// to its input are pushed to output, for the pictures which have one. It
+// is closed once they all are read.
+class XmpReader : public Job {
+    Q_OBJECT
+public:
+    explicit XmpReader(RatedPathQueue* output);
+    PathQueue* input() { return &input_; }
+
+protected:
+    Step step() override;
+
+private:
+    PathQueue input_{this};
+    RatedPathQueue* output_;
+};
+
+} // picpic